@@ -0,0 +1,726 @@
+/*
+ * bench.c - Benchmarks for the loader's building blocks
+ * Copyright 2012 Yifan Lu
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "bench.h"
+#include "config.h"
+#include "load.h"
+#include "resolve.h"
+#include "scefuncs.h"
+#include "utils.h"
+
+/********************************************//**
+ *  \brief Runs every benchmark
+ *  
+ *  Results are written to @a path as comma 
+ *  separated lines of name, iterations, bytes 
+ *  and microseconds, and also to the log.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_bench_run (const char *path)   ///< Where to write results
+{
+    bench_t bench;
+    static const char header[] = "name,iterations,bytes,us\n";
+
+    bench.fd = sceIoOpen (path, PSP2_O_WRONLY | PSP2_O_CREAT | PSP2_O_TRUNC, PSP2_STM_RWU);
+    if (bench.fd < 0)
+    {
+        LOG ("Cannot open benchmark results %s", path);
+        return -1;
+    }
+    sceIoWrite (bench.fd, header, sizeof (header) - 1);
+    bench.block = sceKernelAllocMemBlock ("UVLBench", 0xC20D060, BENCH_BUFFER_SIZE, NULL);
+    if (bench.block < 0 || sceKernelGetMemBlockBase (bench.block, (void**)&bench.buffer) < 0)
+    {
+        LOG ("Cannot allocate benchmark memory.");
+        sceIoClose (bench.fd);
+        return -1;
+    }
+    bench.code_block = sceKernelAllocCodeMemBlock ("UVLBenchCode", BENCH_CODE_SIZE);
+    if (bench.code_block < 0 || sceKernelGetMemBlockBase (bench.code_block, (void**)&bench.code) < 0)
+    {
+        LOG ("Cannot allocate benchmark code memory.");
+        sceKernelFreeMemBlock (bench.block);
+        sceIoClose (bench.fd);
+        return -1;
+    }
+
+    LOG ("Running benchmarks.");
+    uvl_bench_memory (&bench);
+    uvl_bench_memstr (&bench);
+    uvl_bench_crc (&bench);
+    uvl_bench_stubs (&bench);
+    uvl_bench_nid_find (&bench);
+    uvl_bench_module_tables (&bench);
+    if (uvl_bench_load (&bench) < 0)
+    {
+        LOG ("Load benchmark failed.");
+    }
+    if (uvl_bench_resolve (&bench) < 0)
+    {
+        LOG ("Resolve table benchmark failed.");
+    }
+    if (uvl_bench_imports (&bench, 0x100) < 0 ||
+        uvl_bench_imports (&bench, 0x1000) < 0 ||
+        uvl_bench_imports (&bench, 0x4000) < 0)
+    {
+        LOG ("Import resolution benchmark failed.");
+    }
+    if (uvl_bench_variables (&bench) < 0)
+    {
+        LOG ("Variable export benchmark failed.");
+    }
+    if (uvl_bench_io (&bench, UVL_HOMEBREW_PATH) < 0)
+    {
+        LOG ("IO benchmark failed.");
+    }
+    uvl_bench_threads (&bench);
+    LOG ("Benchmarks done.");
+
+    sceKernelFreeMemBlock (bench.code_block);
+    sceKernelFreeMemBlock (bench.block);
+    sceIoClose (bench.fd);
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Writes one result
+ ***********************************************/
+void
+uvl_bench_report (bench_t *bench,       ///< Benchmark state
+              const char *name,         ///< Name of the measurement
+                   u32_t iterations,    ///< Number of operations
+                   u32_t bytes,         ///< Bytes processed, or zero
+                   u32_t time)          ///< Total microseconds
+{
+    char line[MAX_LOG_LENGTH];
+
+    sprintf (line, "%s,%u,%u,%u\n", name, iterations, bytes, time);
+    sceIoWrite (bench->fd, line, strlen (line));
+    LOG ("%s: %u iterations, %u bytes in %u us", name, iterations, bytes, time);
+}
+
+/********************************************//**
+ *  \brief Measures memcpy and memset
+ ***********************************************/
+void
+uvl_bench_memory (bench_t *bench)   ///< Benchmark state
+{
+    u32_t half;
+    u32_t start;
+    u32_t i;
+
+    half = BENCH_BUFFER_SIZE / 2;
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        memset (bench->buffer, i, BENCH_BUFFER_SIZE);
+    }
+    uvl_bench_report (bench, "memset", BENCH_REPEAT, BENCH_REPEAT * BENCH_BUFFER_SIZE, sceKernelGetSystemTimeLow () - start);
+
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        memcpy (&bench->buffer[half * (i & 1)], &bench->buffer[half * !(i & 1)], half);
+    }
+    uvl_bench_report (bench, "memcpy", BENCH_REPEAT, BENCH_REPEAT * half, sceKernelGetSystemTimeLow () - start);
+}
+
+/********************************************//**
+ *  \brief Measures memstr over a buffer 
+ *  without a match
+ ***********************************************/
+void
+uvl_bench_memstr (bench_t *bench)   ///< Benchmark state
+{
+    u32_t start;
+    u32_t i;
+
+    memset (bench->buffer, 'U', BENCH_BUFFER_SIZE);
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        if (memstr ((char*)bench->buffer, BENCH_BUFFER_SIZE, BENCH_NEEDLE, sizeof (BENCH_NEEDLE) - 1) != NULL)
+        {
+            LOG ("Unexpected match in benchmark buffer.");
+        }
+    }
+    uvl_bench_report (bench, "memstr", BENCH_REPEAT, BENCH_REPEAT * BENCH_BUFFER_SIZE, sceKernelGetSystemTimeLow () - start);
+}
+
+/********************************************//**
+ *  \brief Measures crc32 and crc32_copy
+ *  
+ *  crc32_copy is compared with memcpy to 
+ *  see what verifying segments while loading 
+ *  them costs.
+ ***********************************************/
+void
+uvl_bench_crc (bench_t *bench)  ///< Benchmark state
+{
+    u32_t half;
+    u32_t crc;
+    u32_t start;
+    u32_t i;
+
+    half = BENCH_BUFFER_SIZE / 2;
+    crc = 0;
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        crc = crc32 (crc, bench->buffer, BENCH_BUFFER_SIZE);
+    }
+    uvl_bench_report (bench, "crc32", BENCH_REPEAT, BENCH_REPEAT * BENCH_BUFFER_SIZE, sceKernelGetSystemTimeLow () - start);
+
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        crc = crc32_copy (crc, &bench->buffer[half * (i & 1)], &bench->buffer[half * !(i & 1)], half);
+    }
+    uvl_bench_report (bench, "crc32_copy", BENCH_REPEAT, BENCH_REPEAT * half, sceKernelGetSystemTimeLow () - start);
+    IF_VERBOSE LOG ("Benchmark checksum 0x%08X", crc);
+}
+
+/********************************************//**
+ *  \brief Measures resolve table inserts, 
+ *  sorting, and lookups
+ *  
+ *  NIDs are pseudo-random so the sort and 
+ *  search do real work.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_bench_resolve (bench_t *bench)  ///< Benchmark state
+{
+    resolve_entry_t entry;
+    u32_t start;
+    u32_t nid;
+    u32_t i;
+
+    if (uvl_resolve_table_initialize () < 0)
+    {
+        return -1;
+    }
+    entry.type = RESOLVE_TYPE_FUNCTION;
+    entry.value.value = 0;
+    nid = 1;
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_RESOLVE_ENTRIES; i++)
+    {
+        nid = nid * 1664525 + 1013904223;
+        entry.nid = nid;
+        if (uvl_resolve_table_add (&entry) < 0)
+        {
+            uvl_resolve_table_destroy ();
+            return -1;
+        }
+    }
+    uvl_bench_report (bench, "resolve_add", BENCH_RESOLVE_ENTRIES, 0, sceKernelGetSystemTimeLow () - start);
+
+    start = sceKernelGetSystemTimeLow ();
+    uvl_resolve_table_sort ();
+    uvl_bench_report (bench, "resolve_sort", BENCH_RESOLVE_ENTRIES, 0, sceKernelGetSystemTimeLow () - start);
+
+    nid = 1;
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_RESOLVE_ENTRIES; i++)
+    {
+        nid = nid * 1664525 + 1013904223;
+        if (uvl_resolve_table_lookup (nid, &entry) < 0)
+        {
+            LOG ("Lost NID 0x%08X in resolve table.", nid);
+        }
+    }
+    uvl_bench_report (bench, "resolve_lookup", BENCH_RESOLVE_ENTRIES, 0, sceKernelGetSystemTimeLow () - start);
+
+    return uvl_resolve_table_destroy ();
+}
+
+/********************************************//**
+ *  \brief Measures batch import resolution 
+ *  against resolving one NID at a time
+ *  
+ *  Fills the resolve table with @a entries 
+ *  pseudo-random NIDs and resolves an import 
+ *  table of @c BENCH_IMPORTS of them, once 
+ *  with the merge-join and once with a table 
+ *  lookup per NID.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_bench_imports (bench_t *bench,  ///< Benchmark state
+                     u32_t entries) ///< Resolve table size, a power of two no less than @c BENCH_IMPORTS
+{
+    module_imports_t import;
+    resolve_entry_t entry;
+    resolve_entry_t *resolve;
+    char name[32];
+    u32_t *nids;
+    void **stubs;
+    u32_t step;
+    u32_t start;
+    u32_t nid;
+    u32_t i, j;
+
+    if (uvl_resolve_table_initialize () < 0)
+    {
+        return -1;
+    }
+    nids = (u32_t*)bench->buffer;
+    stubs = (void**)&nids[BENCH_IMPORTS];
+    step = entries >> BENCH_IMPORTS_SHIFT;
+    entry.type = RESOLVE_TYPE_FUNCTION;
+    nid = 1;
+    for (i = 0, j = 0; i < entries; i++)
+    {
+        nid = nid * 1664525 + 1013904223;
+        entry.nid = nid;
+        entry.value.value = 0x81000000 + i * STUB_FUNC_SIZE;
+        if (uvl_resolve_table_add (&entry) < 0)
+        {
+            uvl_resolve_table_destroy ();
+            return -1;
+        }
+        if ((i & (step - 1)) == 0 && j < BENCH_IMPORTS)
+        {
+            nids[j] = nid;
+            stubs[j] = &bench->code[j * STUB_FUNC_SIZE];
+            j++;
+        }
+    }
+    uvl_resolve_table_sort ();
+
+    memset (&import, 0, sizeof (import));
+    import.size = sizeof (import);
+    import.num_functions = BENCH_IMPORTS;
+    import.lib_name = "SceBench";
+    import.func_nid_table = nids;
+    import.func_entry_table = stubs;
+
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        if (uvl_resolve_imports (&import) < 0)
+        {
+            uvl_resolve_table_destroy ();
+            return -1;
+        }
+    }
+    sprintf (name, "imports_join_%u", entries);
+    uvl_bench_report (bench, name, BENCH_REPEAT * BENCH_IMPORTS, 0, sceKernelGetSystemTimeLow () - start);
+
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        for (j = 0; j < BENCH_IMPORTS; j++)
+        {
+            resolve = uvl_resolve_table_get (nids[j]);
+            if (resolve == NULL || uvl_resolve_entry_to_import_stub (resolve, stubs[j]) < 0)
+            {
+                uvl_resolve_table_destroy ();
+                return -1;
+            }
+        }
+    }
+    sprintf (name, "imports_each_%u", entries);
+    uvl_bench_report (bench, name, BENCH_REPEAT * BENCH_IMPORTS, 0, sceKernelGetSystemTimeLow () - start);
+
+    return uvl_resolve_table_destroy ();
+}
+
+/********************************************//**
+ *  \brief Measures reading exported variables 
+ *  when added against when imported
+ *  
+ *  Adds @c BENCH_VARIABLES variables spread 
+ *  over the buffer, once read right away as 
+ *  @c RESOLVE_TYPE_VARIABLE and once as 
+ *  @c RESOLVE_TYPE_VARIABLE_REF, then imports 
+ *  one in 2^@c BENCH_VARIABLES_SHIFT of them 
+ *  like a homebrew using few of a module's 
+ *  variables.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_bench_variables (bench_t *bench)    ///< Benchmark state
+{
+    static const u32_t types[2] = {RESOLVE_TYPE_VARIABLE, RESOLVE_TYPE_VARIABLE_REF};
+    static const char *names[2] = {"variables_eager", "variables_deferred"};
+    resolve_entry_t entry;
+    resolve_entry_t *resolve;
+    u32_t *value;
+    u32_t *slots;
+    u32_t start;
+    u32_t time;
+    u32_t mode;
+    u32_t pass;
+    u32_t i, j;
+
+    for (i = 0; i < BENCH_VARIABLES; i++)
+    {
+        value = (u32_t*)((u32_t)bench->buffer + i * BENCH_VARIABLE_STRIDE);
+        *value = i ^ BENCH_VALUE_KEY;
+    }
+    slots = (u32_t*)bench->code;
+    for (mode = 0; mode < 2; mode++)
+    {
+        time = 0;
+        entry.type = types[mode];
+        for (pass = 0; pass < BENCH_REPEAT; pass++)
+        {
+            if (uvl_resolve_table_initialize () < 0)
+            {
+                return -1;
+            }
+            start = sceKernelGetSystemTimeLow ();
+            for (i = 0; i < BENCH_VARIABLES; i++)
+            {
+                value = (u32_t*)((u32_t)bench->buffer + i * BENCH_VARIABLE_STRIDE);
+                entry.nid = BENCH_VARIABLE_NID (i);
+                if (entry.type == RESOLVE_TYPE_VARIABLE)
+                {
+                    entry.value.value = *value;
+                }
+                else
+                {
+                    entry.value.ptr = value;
+                }
+                if (uvl_resolve_table_add (&entry) < 0)
+                {
+                    uvl_resolve_table_destroy ();
+                    return -1;
+                }
+            }
+            uvl_resolve_table_sort ();
+            for (i = 0, j = 0; i < BENCH_VARIABLES; i += 1 << BENCH_VARIABLES_SHIFT, j++)
+            {
+                resolve = uvl_resolve_table_get (BENCH_VARIABLE_NID (i));
+                if (resolve == NULL || uvl_resolve_entry_to_import_stub (resolve, &slots[j]) < 0)
+                {
+                    uvl_resolve_table_destroy ();
+                    return -1;
+                }
+            }
+            time += sceKernelGetSystemTimeLow () - start;
+            if (uvl_resolve_table_destroy () < 0)
+            {
+                return -1;
+            }
+            for (i = 0, j = 0; i < BENCH_VARIABLES; i += 1 << BENCH_VARIABLES_SHIFT, j++)
+            {
+                if (slots[j] != (i ^ BENCH_VALUE_KEY))
+                {
+                    LOG ("Variable %u imported as 0x%08X.", i, slots[j]);
+                    return -1;
+                }
+            }
+        }
+        uvl_bench_report (bench, names[mode], BENCH_REPEAT * BENCH_VARIABLES, 0, time);
+    }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Measures stub patching and the 
+ *  memory unlock it needs
+ ***********************************************/
+void
+uvl_bench_stubs (bench_t *bench)    ///< Benchmark state
+{
+    resolve_entry_t entry;
+    u32_t start;
+    u32_t i;
+
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_STUBS; i++)
+    {
+        psvUnlockMem ();
+        ((u32_t*)bench->code)[i] = 0;
+        psvLockMem ();
+    }
+    uvl_bench_report (bench, "unlock_lock", BENCH_STUBS, 0, sceKernelGetSystemTimeLow () - start);
+
+    entry.nid = 0;
+    entry.type = RESOLVE_TYPE_FUNCTION;
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_STUBS; i++)
+    {
+        entry.value.value = 0x81000000 + i * STUB_FUNC_SIZE;
+        uvl_resolve_entry_to_import_stub (&entry, &bench->code[i * STUB_FUNC_SIZE]);
+    }
+    uvl_bench_report (bench, "stub_patch", BENCH_STUBS, BENCH_STUBS * STUB_FUNC_SIZE, sceKernelGetSystemTimeLow () - start);
+}
+
+/********************************************//**
+ *  \brief Measures NID table searches
+ *  
+ *  Searches tables of 16 to 1024 NIDs, the 
+ *  range of export tables from small libraries 
+ *  up to sceLibKernel and SceLibc, for two 
+ *  needles that are not there. Each length is 
+ *  timed with @c nid_find, which is NEON when 
+ *  built with NEON=1, and with a scalar loop.
+ ***********************************************/
+void
+uvl_bench_nid_find (bench_t *bench)     ///< Benchmark state
+{
+    static const u32_t needles[2] = {0x935CD196, 0x6C2224BA};
+    char name[32];
+    u32_t *table;
+    u32_t length;
+    u32_t repeat;
+    u32_t shift;
+    u32_t start;
+    u32_t found;
+    u32_t i, j;
+
+    table = (u32_t*)bench->buffer;
+    for (i = 0; i < 1024; i++)
+    {
+        table[i] = i * 0x9E3779B1 | 1; // needles are even
+    }
+    for (shift = 4; shift <= 10; shift += 2)
+    {
+        length = 1 << shift;
+        repeat = BENCH_NID_WORDS >> shift;
+        found = 0;
+        start = sceKernelGetSystemTimeLow ();
+        for (i = 0; i < repeat; i++)
+        {
+            found |= nid_find (table, length, needles, 2) >= 0;
+        }
+        sprintf (name, "nid_find_%u", length);
+        uvl_bench_report (bench, name, repeat, BENCH_NID_WORDS * sizeof (u32_t), sceKernelGetSystemTimeLow () - start);
+
+        start = sceKernelGetSystemTimeLow ();
+        for (i = 0; i < repeat; i++)
+        {
+            for (j = 0; j < length; j++)
+            {
+                if (table[j] == needles[0] || table[j] == needles[1])
+                {
+                    found = 1;
+                    break;
+                }
+            }
+        }
+        sprintf (name, "nid_scalar_%u", length);
+        uvl_bench_report (bench, name, repeat, BENCH_NID_WORDS * sizeof (u32_t), sceKernelGetSystemTimeLow () - start);
+        if (found)
+        {
+            LOG ("Unexpected NID match in benchmark table.");
+        }
+    }
+}
+
+/********************************************//**
+ *  \brief Measures walking export tables
+ *  
+ *  Builds synthetic tables with their arrays 
+ *  spread over the buffer, then sums every NID 
+ *  and entry with a fixed stride walk and with 
+ *  the prefetching iterator.
+ ***********************************************/
+void
+uvl_bench_module_tables (bench_t *bench)    ///< Benchmark state
+{
+    module_ports_iter_t iter;
+    module_ports_t *table;
+    module_exports_t *exports;
+    module_exports_t *end;
+    u32_t *arrays;
+    u32_t sum;
+    u32_t start;
+    u32_t i, j;
+
+    exports = (module_exports_t*)bench->buffer;
+    end = &exports[BENCH_MODULE_TABLES];
+    arrays = (u32_t*)end;
+    memset (exports, 0, BENCH_MODULE_TABLES * sizeof (module_exports_t));
+    for (i = 0; i < BENCH_MODULE_TABLES; i++)
+    {
+        exports[i].size = sizeof (module_exports_t);
+        exports[i].num_functions = BENCH_MODULE_NIDS;
+        exports[i].nid_table = (u32_t*)((u32_t)arrays + i * BENCH_MODULE_STRIDE);
+        exports[i].entry_table = (void**)&exports[i].nid_table[BENCH_MODULE_NIDS];
+        for (j = 0; j < BENCH_MODULE_NIDS; j++)
+        {
+            exports[i].nid_table[j] = i ^ j;
+            exports[i].entry_table[j] = (void*)j;
+        }
+    }
+
+    sum = 0;
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        for (exports = (module_exports_t*)bench->buffer; exports < end; exports++)
+        {
+            for (j = 0; j < exports->num_functions; j++)
+            {
+                sum += exports->nid_table[j] + (u32_t)exports->entry_table[j];
+            }
+        }
+    }
+    uvl_bench_report (bench, "module_tables_fixed", BENCH_REPEAT * BENCH_MODULE_TABLES, BENCH_REPEAT * BENCH_MODULE_TABLES * BENCH_MODULE_NIDS * 8, sceKernelGetSystemTimeLow () - start);
+
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        uvl_module_ports_begin (&iter, bench->buffer, end, MODULE_PORTS_EXPORTS, 0);
+        while ((table = uvl_module_ports_next (&iter)) != NULL)
+        {
+            for (j = 0; j < table->exports.num_functions; j++)
+            {
+                sum -= table->exports.nid_table[j] + (u32_t)table->exports.entry_table[j];
+            }
+        }
+    }
+    uvl_bench_report (bench, "module_tables", BENCH_REPEAT * BENCH_MODULE_TABLES, BENCH_REPEAT * BENCH_MODULE_TABLES * BENCH_MODULE_NIDS * 8, sceKernelGetSystemTimeLow () - start);
+    if (sum != 0)
+    {
+        LOG ("Module table walks disagree.");
+    }
+}
+
+/********************************************//**
+ *  \brief Measures loading a large image on 
+ *  one thread and on all workers
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_bench_load (bench_t *bench)     ///< Benchmark state
+{
+    static const char *names[] = {"load_serial", "load_parallel"};
+    static const u32_t threads[] = {1, UVL_LOAD_MAX_THREADS};
+    load_work_t work;
+    PsvUID block;
+    u8_t *image;
+    u32_t copy;
+    u32_t start;
+    u32_t i;
+
+    block = sceKernelAllocMemBlock ("UVLBenchLoad", 0xC20D060, 2 * BENCH_LOAD_SIZE, NULL);
+    if (block < 0 || sceKernelGetMemBlockBase (block, (void**)&image) < 0)
+    {
+        LOG ("Cannot allocate benchmark image.");
+        return -1;
+    }
+    copy = BENCH_LOAD_SIZE - (BENCH_LOAD_SIZE >> 2);
+    memset (image, 0x55, copy);
+    for (i = 0; i < sizeof (threads) / sizeof (threads[0]); i++)
+    {
+        memset (&work, 0, sizeof (work));
+        uvl_load_work_add (&work, &image[BENCH_LOAD_SIZE], image, copy >> 1, 0);
+        uvl_load_work_add (&work, &image[BENCH_LOAD_SIZE + (copy >> 1)], &image[copy >> 1], copy - (copy >> 1), BENCH_LOAD_SIZE - copy);
+        start = sceKernelGetSystemTimeLow ();
+        uvl_load_work_run (&work, threads[i]);
+        uvl_bench_report (bench, names[i], work.num_chunks, work.bytes, sceKernelGetSystemTimeLow () - start);
+    }
+    sceKernelFreeMemBlock (block);
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Measures reading a file at several 
+ *  chunk sizes
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_bench_io (bench_t *bench,   ///< Benchmark state
+          const char *path)     ///< File to read
+{
+    static const u32_t chunks[] = {0x1000, 0x4000, 0x10000, 0x40000, 0x100000};
+    static const char *names[] = {"read_4k", "read_16k", "read_64k", "read_256k", "read_1m"};
+    PsvUID fd;
+    PsvOff got;
+    u32_t total, count;
+    u32_t start;
+    u32_t i;
+
+    fd = sceIoOpen (path, PSP2_O_RDONLY, 0);
+    if (fd < 0)
+    {
+        LOG ("Cannot open %s for reading.", path);
+        return -1;
+    }
+    for (i = 0; i < sizeof (chunks) / sizeof (chunks[0]); i++)
+    {
+        if (sceIoLseek (fd, (u64_t)0, PSP2_SEEK_SET) < 0)
+        {
+            sceIoClose (fd);
+            return -1;
+        }
+        total = 0;
+        count = 0;
+        start = sceKernelGetSystemTimeLow ();
+        while ((got = sceIoRead (fd, bench->buffer, chunks[i])) > 0)
+        {
+            total += got;
+            count++;
+        }
+        uvl_bench_report (bench, names[i], count, total, sceKernelGetSystemTimeLow () - start);
+    }
+    sceIoClose (fd);
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Thread that does nothing
+ *  
+ *  \returns Zero
+ ***********************************************/
+static int
+uvl_bench_thread (u32_t args,   ///< Unused
+                   void *argp)  ///< Unused
+{
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Measures creating, starting, and 
+ *  joining a thread
+ ***********************************************/
+void
+uvl_bench_threads (bench_t *bench)  ///< Benchmark state
+{
+    PsvUID thread;
+    u32_t start;
+    u32_t count;
+    int status;
+    u32_t i;
+
+    count = 0;
+    start = sceKernelGetSystemTimeLow ();
+    for (i = 0; i < BENCH_THREADS; i++)
+    {
+        thread = sceKernelCreateThread ("uvlbench", uvl_bench_thread, 0x10000100, 0x00001000, 0, (0x01 << 16 | 0x02 << 16 | 0x04 << 16), NULL);
+        if (thread < 0)
+        {
+            LOG ("Cannot create benchmark thread.");
+            break;
+        }
+        if (sceKernelStartThread (thread, 0, NULL) >= 0)
+        {
+            sceKernelWaitThreadEnd (thread, &status, NULL);
+            count++;
+        }
+        sceKernelDeleteThread (thread);
+    }
+    uvl_bench_report (bench, "thread_join", count, 0, sceKernelGetSystemTimeLow () - start);
+}
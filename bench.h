@@ -0,0 +1,61 @@
+/// 
+/// \file bench.h
+/// \brief On-device benchmarks
+/// \defgroup bench Benchmarks
+/// \brief Measures the operations the loader relies on
+/// @{
+/// 
+#ifndef UVL_BENCH_H
+#define UVL_BENCH_H
+
+#include "types.h"
+
+#define BENCH_BUFFER_SIZE       0x100000    ///< Scratch memory used by the suite
+#define BENCH_REPEAT            16          ///< Passes over the buffer for memory benchmarks
+#define BENCH_RESOLVE_ENTRIES   0x4000      ///< Entries added to and looked up in the resolve table
+#define BENCH_VALUE_KEY         0x5A5AA5A5  ///< Variables hold their index XOR this, so imports can be checked
+#define BENCH_STUBS             0x1000      ///< Stubs patched
+#define BENCH_IMPORTS_SHIFT     8           ///< Log2 of the imports resolved against each table size
+#define BENCH_IMPORTS           (1 << BENCH_IMPORTS_SHIFT)  ///< Imports resolved against each table size
+#define BENCH_VARIABLES         0x1000      ///< Exported variables added, spread over the buffer
+#define BENCH_VARIABLES_SHIFT   4           ///< Log2 of exported variables per imported one
+#define BENCH_VARIABLE_STRIDE   (BENCH_BUFFER_SIZE / BENCH_VARIABLES)   ///< Bytes between exported variables
+#define BENCH_VARIABLE_NID(i)   ((u32_t)(i) * 0x9E3779B1)               ///< NID of exported variable @a i, not in order
+#define BENCH_CODE_SIZE         0x100000    ///< Code memory for patched stubs, same rounding as segments
+#define BENCH_NID_WORDS         0x40000     ///< NIDs compared per table length in the search benchmark
+#define BENCH_THREADS           32          ///< Threads created and joined
+#define BENCH_MODULE_TABLES     0x400       ///< Synthetic export tables walked
+#define BENCH_MODULE_NIDS       16          ///< Functions in each synthetic export table
+#define BENCH_MODULE_STRIDE     0x300       ///< Distance between the arrays of consecutive tables
+#define BENCH_LOAD_SIZE         0x400000    ///< Bytes of the synthetic image loaded, a quarter of it zero filled
+#define BENCH_NEEDLE            "UVLBENCH"  ///< String that is never in the scanned buffer
+
+/**
+ * \brief Benchmark state
+ */
+typedef struct bench
+{
+    PsvUID  fd;             ///< Results file
+    PsvUID  block;          ///< Scratch memory block
+    u8_t    *buffer;        ///< Scratch memory
+    PsvUID  code_block;     ///< Code memory block, where stubs live
+    u8_t    *code;          ///< Code memory
+} bench_t;
+
+int uvl_bench_run (const char *path);
+void uvl_bench_report (bench_t *bench, const char *name, u32_t iterations, u32_t bytes, u32_t time);
+void uvl_bench_memory (bench_t *bench);
+void uvl_bench_memstr (bench_t *bench);
+void uvl_bench_crc (bench_t *bench);
+int uvl_bench_resolve (bench_t *bench);
+int uvl_bench_imports (bench_t *bench, u32_t entries);
+int uvl_bench_variables (bench_t *bench);
+void uvl_bench_stubs (bench_t *bench);
+void uvl_bench_nid_find (bench_t *bench);
+void uvl_bench_module_tables (bench_t *bench);
+int uvl_bench_load (bench_t *bench);
+int uvl_bench_io (bench_t *bench, const char *path);
+void uvl_bench_threads (bench_t *bench);
+
+#endif
+/// @}
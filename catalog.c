@@ -0,0 +1,449 @@
+/*
+ * catalog.c - Keeps an index of homebrew on the memory card
+ * Copyright 2012 Yifan Lu
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "catalog.h"
+#include "load.h"
+#include "resolve.h"
+#include "scefuncs.h"
+#include "utils.h"
+
+/** Size of a catalog with every record in use */
+#define CATALOG_SIZE (sizeof (catalog_header_t) + CATALOG_MAX_ENTRIES * sizeof (catalog_record_t))
+
+/********************************************//**
+ *  \brief Reads the catalog index
+ *  
+ *  A menu can get every executable's metadata 
+ *  with this one read.
+ *  \returns Number of records on success, 
+ *  otherwise error
+ ***********************************************/
+int
+uvl_catalog_read (const char *index_path,       ///< Catalog index file
+            catalog_header_t *catalog,          ///< Where to read the header and records to
+                       u32_t max)               ///< Maximum number of records to read
+{
+    PsvUID fd;
+    PsvSSize size;
+
+    fd = sceIoOpen (index_path, PSP2_O_RDONLY, 0);
+    if (fd < 0)
+    {
+        IF_DEBUG LOG ("No catalog at %s", index_path);
+        return -1;
+    }
+    size = sceIoRead (fd, catalog, sizeof (catalog_header_t) + max * sizeof (catalog_record_t));
+    sceIoClose (fd);
+    if (size < (PsvSSize)sizeof (catalog_header_t) || catalog->magic != CATALOG_MAGIC || 
+        catalog->version != CATALOG_VERSION || catalog->record_size != sizeof (catalog_record_t))
+    {
+        LOG ("Catalog %s is invalid or out of date.", index_path);
+        return -1;
+    }
+    if (catalog->count > max || sizeof (catalog_header_t) + catalog->count * sizeof (catalog_record_t) > size)
+    {
+        LOG ("Catalog %s is truncated.", index_path);
+        return -1;
+    }
+    return catalog->count;
+}
+
+/********************************************//**
+ *  \brief Finds where a loaded address is in 
+ *  an executable file
+ *  
+ *  \returns Pointer into the file or NULL if 
+ *  it is not in the file or is compressed
+ ***********************************************/
+static void *
+uvl_catalog_map (void *data,                    ///< File contents
+                u32_t size,                     ///< File size
+         Elf32_Phdr_t *prog_hdrs,               ///< Program headers
+                u32_t count,                    ///< Number of program headers
+   sce_segment_info_t *seg_infos,               ///< Segment infos of a SELF, NULL for ELF
+                u32_t vaddr,                    ///< Loaded address
+                u32_t length)                   ///< Bytes needed at @a vaddr
+{
+    u32_t offset;
+    u32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (prog_hdrs[i].p_type != PT_LOAD || vaddr < (u32_t)prog_hdrs[i].p_vaddr || vaddr + length > (u32_t)prog_hdrs[i].p_vaddr + prog_hdrs[i].p_filesz)
+        {
+            continue;
+        }
+        if (seg_infos != NULL)
+        {
+            if (seg_infos[i].compression == SCE_SEGMENT_COMPRESSED)
+            {
+                return NULL;
+            }
+            offset = (u32_t)seg_infos[i].offset;
+        }
+        else
+        {
+            offset = prog_hdrs[i].p_offset;
+        }
+        offset += vaddr - (u32_t)prog_hdrs[i].p_vaddr;
+        if (offset + length > size)
+        {
+            return NULL;
+        }
+        return (void*)((u32_t)data + offset);
+    }
+    return NULL;
+}
+
+/********************************************//**
+ *  \brief Reads metadata from an executable 
+ *  in memory
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+static int
+uvl_catalog_parse_exe (void *data,              ///< File contents
+                      u32_t size,               ///< File size
+           catalog_record_t *record)            ///< Record to fill
+{
+    sce_header_t *sce_hdr;
+    sce_segment_info_t *seg_infos;
+    Elf32_Ehdr_t *elf_hdr;
+    Elf32_Phdr_t *prog_hdrs;
+    module_info_t *mod_info;
+    module_ports_iter_t iter;
+    module_imports_t *import;
+    char *name;
+    u32_t offset;
+    u32_t used;
+    u32_t i, j;
+
+    sce_hdr = data;
+    seg_infos = NULL;
+    if (size >= sizeof (sce_header_t) && memcmp (data, "SCE\0", MAGIC_LEN) == 0)
+    {
+        if (sce_hdr->header_type != SCE_TYPE_SELF || (u32_t)sce_hdr->elf_offset + sizeof (Elf32_Ehdr_t) > size)
+        {
+            return -1;
+        }
+        record->flags |= CATALOG_FLAG_SELF;
+        elf_hdr = (void*)((u32_t)data + (u32_t)sce_hdr->elf_offset);
+    }
+    else if (size >= sizeof (Elf32_Ehdr_t))
+    {
+        elf_hdr = data;
+    }
+    else
+    {
+        return -1;
+    }
+    // most files in the directory are not executables, skip them quietly
+    if (!(elf_hdr->e_ident[EI_MAG0] == ELFMAG0 && elf_hdr->e_ident[EI_MAG1] == ELFMAG1 && elf_hdr->e_ident[EI_MAG2] == ELFMAG2 && elf_hdr->e_ident[EI_MAG3] == ELFMAG3))
+    {
+        return -1;
+    }
+    if (uvl_elf_check_header (elf_hdr) < 0 || elf_hdr->e_phnum < 1)
+    {
+        return -1;
+    }
+    if (record->flags & CATALOG_FLAG_SELF)
+    {
+        if ((u32_t)sce_hdr->phdr_offset + elf_hdr->e_phnum * sizeof (Elf32_Phdr_t) > size || 
+            (u32_t)sce_hdr->section_info_offset + elf_hdr->e_phnum * sizeof (sce_segment_info_t) > size)
+        {
+            return -1;
+        }
+        prog_hdrs = (void*)((u32_t)data + (u32_t)sce_hdr->phdr_offset);
+        seg_infos = (void*)((u32_t)data + (u32_t)sce_hdr->section_info_offset);
+    }
+    else
+    {
+        if (elf_hdr->e_phoff + elf_hdr->e_phnum * sizeof (Elf32_Phdr_t) > size)
+        {
+            return -1;
+        }
+        prog_hdrs = (void*)((u32_t)data + elf_hdr->e_phoff);
+    }
+
+    // same rounding as uvl_elf_alloc_segment
+    record->footprint = 0;
+    for (i = 0; i < elf_hdr->e_phnum; i++)
+    {
+        if (prog_hdrs[i].p_type == PT_LOAD && prog_hdrs[i].p_vaddr != 0)
+        {
+            record->footprint += (prog_hdrs[i].p_memsz + 0xFFFFF) & ~0xFFFFF;
+        }
+    }
+
+    // metadata is only readable from uncompressed segments
+    mod_info = NULL;
+    if (uvl_elf_get_module_info_offset (&prog_hdrs[0], &offset) == 0)
+    {
+        mod_info = uvl_catalog_map (data, size, prog_hdrs, elf_hdr->e_phnum, seg_infos, (u32_t)prog_hdrs[0].p_vaddr + offset, sizeof (module_info_t));
+    }
+    else if (seg_infos == NULL)
+    {
+        uvl_elf_get_module_info (data, size, elf_hdr, &mod_info);
+    }
+    if (mod_info == NULL)
+    {
+        return 0;
+    }
+    memcpy (record->modname, mod_info->modname, sizeof (mod_info->modname));
+    record->modname[sizeof (record->modname) - 1] = '\0';
+    import = uvl_catalog_map (data, size, prog_hdrs, elf_hdr->e_phnum, seg_infos, (u32_t)prog_hdrs[0].p_vaddr + mod_info->stub_top, mod_info->stub_end - mod_info->stub_top);
+    if (import == NULL)
+    {
+        return 0;
+    }
+    uvl_module_ports_begin (&iter, import, (void*)((u32_t)import + mod_info->stub_end - mod_info->stub_top), MODULE_PORTS_IMPORTS, 0);
+    used = 0;
+    while ((import = (module_imports_t*)uvl_module_ports_next (&iter)) != NULL)
+    {
+        name = uvl_catalog_map (data, size, prog_hdrs, elf_hdr->e_phnum, seg_infos, (u32_t)import->lib_name, 1);
+        if (name == NULL)
+        {
+            continue;
+        }
+        for (j = 0; used + j < CATALOG_LIBS_LENGTH - 1 && (u32_t)&name[j] < (u32_t)data + size && name[j] != '\0'; j++)
+        {
+            record->libs[used + j] = name[j];
+        }
+        if (used + j >= CATALOG_LIBS_LENGTH - 1)
+        {
+            LOG ("Too many libraries in %s, list is cut short.", record->path);
+            break;
+        }
+        record->libs[used + j] = '\0';
+        used += j + 1;
+        record->num_libs++;
+    }
+    record->flags |= CATALOG_FLAG_PARSED;
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Adds the rest of a file to a CRC
+ *  
+ *  Reads from @a offset to the end of the file 
+ *  through @a buffer, one block at a time.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+static int
+uvl_catalog_crc_rest (const char *path,         ///< File to read
+                           u32_t offset,        ///< Bytes already in the CRC
+                            void *buffer,       ///< At least @c UVL_BIN_MAX_SIZE bytes
+                           u32_t *crc)          ///< CRC so far, updated
+{
+    PsvUID fd;
+    PsvSSize size;
+
+    fd = sceIoOpen (path, PSP2_O_RDONLY, 0);
+    if (fd < 0)
+    {
+        LOG ("Cannot open %s", path);
+        return -1;
+    }
+    if (sceIoLseek (fd, (u64_t)offset, PSP2_SEEK_SET) < 0)
+    {
+        LOG ("Cannot seek %s", path);
+        sceIoClose (fd);
+        return -1;
+    }
+    while ((size = sceIoRead (fd, buffer, UVL_BIN_MAX_SIZE)) > 0)
+    {
+        *crc = crc32 (*crc, buffer, size);
+    }
+    sceIoClose (fd);
+    if (size < 0)
+    {
+        LOG ("Cannot read %s", path);
+        return -1;
+    }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Reads metadata of one executable
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_catalog_parse (const char *path,            ///< Absolute path to executable
+                    PsvIoStat *stat,            ///< File status from the directory
+             catalog_record_t *record)          ///< Record to fill
+{
+    void *data;
+    PsvSSize size;
+    int ret;
+
+    memset (record, 0, sizeof (catalog_record_t));
+    strcpy (record->path, path);
+    record->size = (u32_t)stat->st_size;
+    record->mtime = stat->st_mtime;
+    IF_DEBUG LOG ("Parsing %s for catalog.", path);
+    if (uvl_load_file (path, &data, &size) < 0)
+    {
+        return -1;
+    }
+    record->crc = crc32 (0, data, size);
+    ret = uvl_catalog_parse_exe (data, size, record);
+    // the load stops at UVL_BIN_MAX_SIZE, the rest is only needed for the CRC
+    if (ret == 0 && record->size > (u32_t)size && uvl_catalog_crc_rest (path, size, data, &record->crc) < 0)
+    {
+        ret = -1;
+    }
+    if (uvl_free_data (data) < 0)
+    {
+        return -1;
+    }
+    return ret;
+}
+
+/********************************************//**
+ *  \brief Brings the catalog index up to date
+ *  
+ *  Every file in @a dir gets a record. Files 
+ *  with the same size and modification time 
+ *  as in the old index keep their record, and 
+ *  only new or changed files are parsed and 
+ *  have their CRC taken. The index is only 
+ *  written if a record changed.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_catalog_update (const char *dir,            ///< Directory of executables
+                    const char *index_path)     ///< Catalog index file
+{
+    PsvUID block;
+    PsvUID dfd;
+    PsvUID fd;
+    PsvIoDirent dirent;
+    PsvIoStat dir_stat;
+    catalog_header_t *old;
+    catalog_header_t *new;
+    catalog_record_t *old_records;
+    catalog_record_t *new_records;
+    catalog_record_t *record;
+    char path[MAX_PATH_LENGTH];
+    int old_count;
+    u32_t parsed;
+    u32_t i;
+    int ret;
+
+    if (sceIoGetstat (dir, &dir_stat) < 0)
+    {
+        LOG ("Cannot open directory %s", dir);
+        return -1;
+    }
+    block = sceKernelAllocMemBlock ("UVLCatalog", 0xC20D060, (2 * CATALOG_SIZE + 0xFFF) & ~0xFFF, NULL);
+    if (block < 0 || sceKernelGetMemBlockBase (block, (void**)&old) < 0)
+    {
+        LOG ("Cannot allocate memory for catalog.");
+        return -1;
+    }
+    new = (void*)((u32_t)old + CATALOG_SIZE);
+    old_records = (catalog_record_t*)&old[1];
+    new_records = (catalog_record_t*)&new[1];
+    if ((old_count = uvl_catalog_read (index_path, old, CATALOG_MAX_ENTRIES)) < 0)
+    {
+        old_count = 0;
+    }
+
+    dfd = sceIoDopen (dir);
+    if (dfd < 0)
+    {
+        LOG ("Cannot open directory %s", dir);
+        sceKernelFreeMemBlock (block);
+        return -1;
+    }
+    new->magic = CATALOG_MAGIC;
+    new->version = CATALOG_VERSION;
+    new->count = 0;
+    new->record_size = sizeof (catalog_record_t);
+    new->dir_mtime = dir_stat.st_mtime;
+    parsed = 0;
+    while (sceIoDread (dfd, &dirent) > 0)
+    {
+        if ((dirent.d_stat.st_mode & PSP2_S_IFMT) != PSP2_S_IFREG)
+        {
+            continue;
+        }
+        if (strlen (dir) + 1 + strlen (dirent.d_name) >= MAX_PATH_LENGTH)
+        {
+            LOG ("Path too long for %s, skipping.", dirent.d_name);
+            continue;
+        }
+        if (new->count >= CATALOG_MAX_ENTRIES)
+        {
+            LOG ("Catalog full, skipping %s.", dirent.d_name);
+            continue;
+        }
+        sprintf (path, "%s/%s", dir, dirent.d_name);
+        record = &new_records[new->count];
+        for (i = 0; i < old_count; i++)
+        {
+            if (strcmp (old_records[i].path, path) == 0 && 
+                old_records[i].size == (u32_t)dirent.d_stat.st_size && 
+                memcmp (&old_records[i].mtime, &dirent.d_stat.st_mtime, sizeof (PsvDateTime)) == 0)
+            {
+                break;
+            }
+        }
+        if (i < old_count)
+        {
+            memcpy (record, &old_records[i], sizeof (catalog_record_t));
+        }
+        else if (uvl_catalog_parse (path, &dirent.d_stat, record) < 0)
+        {
+            IF_DEBUG LOG ("%s is not an executable, skipping.", path);
+            continue;
+        }
+        else
+        {
+            parsed++;
+        }
+        new->count++;
+    }
+    sceIoDclose (dfd);
+    IF_DEBUG LOG ("Catalog has %u executables, %u parsed.", new->count, parsed);
+
+    // each kept record matches a different old one, so the same count means the same files
+    if (parsed == 0 && new->count == old_count && memcmp (&old->dir_mtime, &new->dir_mtime, sizeof (PsvDateTime)) == 0)
+    {
+        IF_DEBUG LOG ("Catalog of %s is up to date.", dir);
+        sceKernelFreeMemBlock (block);
+        return 0;
+    }
+    ret = 0;
+    fd = sceIoOpen (index_path, PSP2_O_WRONLY | PSP2_O_CREAT | PSP2_O_TRUNC, PSP2_STM_RWU);
+    if (fd < 0)
+    {
+        LOG ("Cannot open %s for writing.", index_path);
+        ret = -1;
+    }
+    else
+    {
+        if (sceIoWrite (fd, new, sizeof (catalog_header_t) + new->count * sizeof (catalog_record_t)) < 0)
+        {
+            LOG ("Cannot write catalog.");
+            ret = -1;
+        }
+        sceIoClose (fd);
+    }
+    sceKernelFreeMemBlock (block);
+    return ret;
+}
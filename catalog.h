@@ -0,0 +1,57 @@
+/// 
+/// \file catalog.h
+/// \brief Index of homebrew on the memory card
+/// \defgroup catalog Homebrew Catalog
+/// \brief Caches executable metadata in one file
+/// @{
+/// 
+#ifndef UVL_CATALOG
+#define UVL_CATALOG
+
+#include "types.h"
+#include "load.h"
+#include "scefuncs.h"
+
+#define CATALOG_MAGIC           0x434C5655  ///< "UVLC"
+#define CATALOG_VERSION         2           ///< Bumped when the header or record layout changes
+#define CATALOG_MAX_ENTRIES     64          ///< Maximum number of executables in the catalog
+#define CATALOG_LIBS_LENGTH     0x200       ///< Space for imported library names per executable
+#define CATALOG_FLAG_SELF       0x1         ///< Executable is a SELF
+#define CATALOG_FLAG_PARSED     0x2         ///< Module info and libraries were read
+
+/**
+ * \brief Catalog file header
+ * 
+ * Followed by @c count records.
+ */
+typedef struct catalog_header
+{
+    u32_t   magic;          ///< @c CATALOG_MAGIC
+    u32_t   version;        ///< @c CATALOG_VERSION
+    u32_t   count;          ///< Number of records
+    u32_t   record_size;    ///< Size of one record
+    PsvDateTime dir_mtime;  ///< Modification time of the directory when scanned
+} catalog_header_t;
+
+/**
+ * \brief One executable in the catalog
+ */
+typedef struct catalog_record
+{
+    char    path[MAX_PATH_LENGTH];      ///< Absolute path to executable
+    u32_t   size;                       ///< File size in bytes
+    u32_t   crc;                        ///< CRC-32 of the whole file
+    PsvDateTime mtime;                  ///< Modification time when parsed
+    u32_t   footprint;                  ///< Memory needed for all segments
+    u32_t   flags;                      ///< See defined "CATALOG_FLAG_"
+    u32_t   num_libs;                   ///< Number of imported libraries
+    char    modname[28];                ///< Module name
+    char    libs[CATALOG_LIBS_LENGTH];  ///< Imported library names, each ending in a null
+} catalog_record_t;
+
+int uvl_catalog_read (const char *index_path, catalog_header_t *catalog, u32_t max);
+int uvl_catalog_update (const char *dir, const char *index_path);
+int uvl_catalog_parse (const char *path, PsvIoStat *stat, catalog_record_t *record);
+
+#endif
+/// @}
@@ -39,32 +39,320 @@ uvl_cleanup_memory ()
     // close all file handles
 }
 
+/**
+ * \brief A module waiting to be unloaded
+ */
+typedef struct unload_job
+{
+    PsvUID  modid;                          ///< UID of the module
+    PsvUID  thread;                         ///< Worker unloading it
+    char    name[28];                       ///< Name of the module, for the report
+    u32_t   num_exports;                    ///< Number of exported libraries
+    u32_t   exports[MAX_MODULE_LIBS];       ///< NIDs of exported libraries
+    u32_t   num_imports;                    ///< Number of imported libraries
+    u32_t   imports[MAX_MODULE_LIBS];       ///< NIDs of imported libraries
+    u32_t   dependents;                     ///< Modules still loaded that import from this one
+    u32_t   time;                           ///< Microseconds taken to stop and unload
+    int     result;                         ///< Return value of @c sceKernelStopUnloadModule
+    int     done;                           ///< Set once unloaded or failed
+} unload_job_t;
+
+/********************************************//**
+ *  \brief Reads the libraries a module exports 
+ *  and imports
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+static int
+uvl_unload_job_init (unload_job_t *job,     ///< Job to fill
+                           PsvUID modid)    ///< UID of the module
+{
+    loaded_module_info_t m_mod_info;
+    module_info_t *mod_info;
+    module_ports_iter_t iter;
+    module_ports_t *table;
+    u32_t base;
+
+    memset (job, 0, sizeof (unload_job_t));
+    job->modid = modid;
+    m_mod_info.size = sizeof (loaded_module_info_t); // should be 440
+    if (sceKernelGetModuleInfo (modid, &m_mod_info) < 0)
+    {
+        LOG ("Error getting info for mod 0x%08X", modid);
+        return -1;
+    }
+    memcpy (job->name, m_mod_info.module_name, sizeof (job->name));
+    job->name[sizeof (job->name) - 1] = '\0';
+    uvl_resolve_table_pin (&m_mod_info);
+    if (uvl_resolve_find_module_info (&m_mod_info, &mod_info) < 0)
+    {
+        return -1; // no known dependencies, unloaded in the first wave
+    }
+    base = (u32_t)m_mod_info.segments[0].vaddr;
+    uvl_module_ports_begin (&iter, (void*)(base + mod_info->ent_top), (void*)(base + mod_info->ent_end), MODULE_PORTS_EXPORTS, 0);
+    while (job->num_exports < MAX_MODULE_LIBS && (table = uvl_module_ports_next (&iter)) != NULL)
+    {
+        job->exports[job->num_exports++] = table->exports.module_nid;
+    }
+    uvl_module_ports_begin (&iter, (void*)(base + mod_info->stub_top), (void*)(base + mod_info->stub_end), MODULE_PORTS_IMPORTS, 0);
+    while (job->num_imports < MAX_MODULE_LIBS && (table = uvl_module_ports_next (&iter)) != NULL)
+    {
+        job->imports[job->num_imports++] = table->imports.module_nid;
+    }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Checks if a module imports from 
+ *  another
+ *  
+ *  \returns One if @a user depends on 
+ *  @a provider, otherwise zero
+ ***********************************************/
+static int
+uvl_unload_job_depends (unload_job_t *user,     ///< Importing module
+                        unload_job_t *provider) ///< Exporting module
+{
+    u32_t i;
+
+    if (user == provider)
+    {
+        return 0;
+    }
+    for (i = 0; i < user->num_imports; i++)
+    {
+        if (nid_find (provider->exports, provider->num_exports, &user->imports[i], 1) != -1)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Stops and unloads the module of a job 
+ *  and times it
+ ***********************************************/
+static void
+uvl_unload_job_run (unload_job_t *job)  ///< Module to unload
+{
+    int status;
+    u32_t start;
+
+    start = sceKernelGetSystemTimeLow ();
+    job->result = sceKernelStopUnloadModule (job->modid, 0, NULL, 0, NULL, &status);
+    job->time = sceKernelGetSystemTimeLow () - start;
+}
+
+/********************************************//**
+ *  \brief Worker thread that unloads a module
+ *  
+ *  \returns Zero
+ ***********************************************/
+static int
+uvl_unload_thread (u32_t args,  ///< Size of @a argp
+                    void *argp) ///< Pointer to the @c unload_job_t pointer
+{
+    uvl_unload_job_run (*(unload_job_t**)argp);
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Unloads a batch of modules in 
+ *  parallel and waits for them
+ ***********************************************/
+static void
+uvl_unload_batch (unload_job_t **batch, ///< Modules to unload
+                         u32_t count)   ///< Number of modules
+{
+    u32_t i;
+    int status;
+
+    for (i = 0; i < count; i++)
+    {
+        batch[i]->thread = sceKernelCreateThread ("uvlunload", uvl_unload_thread, 0x10000100, UVL_UNLOAD_STACK_SIZE, 0, (0x01 << 16 | 0x02 << 16 | 0x04 << 16), NULL);
+        if (batch[i]->thread < 0 || sceKernelStartThread (batch[i]->thread, sizeof (unload_job_t*), &batch[i]) < 0)
+        {
+            // no worker, do it here
+            IF_DEBUG LOG ("Cannot start worker for %s, unloading directly.", batch[i]->name);
+            if (batch[i]->thread >= 0)
+            {
+                sceKernelDeleteThread (batch[i]->thread);
+            }
+            batch[i]->thread = -1;
+            uvl_unload_job_run (batch[i]);
+        }
+    }
+    for (i = 0; i < count; i++)
+    {
+        if (batch[i]->thread >= 0)
+        {
+            sceKernelWaitThreadEnd (batch[i]->thread, &status, NULL);
+            sceKernelDeleteThread (batch[i]->thread);
+        }
+        batch[i]->done = 1;
+    }
+}
+
+/********************************************//**
+ *  \brief Unloads modules in dependency order
+ *  
+ *  A module is only stopped after every module 
+ *  importing from it, so providers outlive 
+ *  their users. Each wave of modules that 
+ *  nothing loaded depends on is unloaded in 
+ *  parallel on worker threads. A dependency 
+ *  cycle is broken by unloading one module of 
+ *  the cycle on its own.
+ *  \returns Number of waves
+ ***********************************************/
+static u32_t
+uvl_unload_jobs (unload_job_t *jobs,    ///< Modules with their dependents counted
+                        u32_t num_jobs) ///< Number of modules
+{
+    unload_job_t *batch[UVL_UNLOAD_MAX_THREADS];
+    unload_job_t *next;
+    unload_job_t *cycle;
+    u32_t count, remaining, wave;
+    u32_t step;
+    int i, j;
+
+    for (remaining = num_jobs, wave = 0; remaining > 0; wave++)
+    {
+        count = 0;
+        next = NULL;
+        for (i = 0; i < num_jobs; i++)
+        {
+            if (!jobs[i].done)
+            {
+                count += (jobs[i].dependents == 0);
+                next = next == NULL ? &jobs[i] : next;
+            }
+        }
+        if (count == 0)
+        {
+            // every module left has a loaded user, so following users 
+            // for as many steps as there are modules ends in a cycle
+            for (step = 0; step < remaining; step++)
+            {
+                for (j = 0; j < num_jobs && (jobs[j].done || !uvl_unload_job_depends (&jobs[j], next)); j++);
+                next = &jobs[j];
+            }
+            // following users from a module of the cycle comes back to it
+            cycle = next;
+            count = 0;
+            do
+            {
+                for (j = 0; j < num_jobs && (jobs[j].done || !uvl_unload_job_depends (&jobs[j], cycle)); j++);
+                cycle = &jobs[j];
+                count++;
+            } while (cycle != next);
+            LOG ("Circular dependency between %u modules, unloading %s first.", count, next->name);
+            batch[0] = next;
+            count = 1;
+        }
+        else
+        {
+            IF_DEBUG LOG ("Unload wave %u.", wave);
+            count = 0;
+            for (i = 0; i < num_jobs; i++)
+            {
+                if (jobs[i].done || jobs[i].dependents != 0)
+                {
+                    continue;
+                }
+                batch[count++] = &jobs[i];
+                if (count == UVL_UNLOAD_MAX_THREADS)
+                {
+                    uvl_unload_batch (batch, count);
+                    remaining -= count;
+                    count = 0;
+                }
+            }
+        }
+        uvl_unload_batch (batch, count);
+        remaining -= count;
+        // release providers of everything unloaded in this wave
+        for (i = 0; i < num_jobs; i++)
+        {
+            if (!jobs[i].done || jobs[i].dependents == (u32_t)-1)
+            {
+                continue;
+            }
+            for (j = 0; j < num_jobs; j++)
+            {
+                if (!jobs[j].done && jobs[j].dependents > 0 && uvl_unload_job_depends (&jobs[i], &jobs[j]))
+                {
+                    jobs[j].dependents--;
+                }
+            }
+            jobs[i].dependents = (u32_t)-1; // counted
+        }
+    }
+    return wave;
+}
+
 /********************************************//**
  *  \brief Unloads loaded modules
  *  
+ *  \sa uvl_unload_jobs
  *  \returns Zero on success, otherwise error
  ***********************************************/
 int
 uvl_unload_all_modules ()
 {
-    loaded_module_info_t m_mod_info;
     PsvUID mod_list[MAX_LOADED_MODS];
     u32_t num_loaded = MAX_LOADED_MODS;
-    int status;
-    int i;
+    PsvUID block;
+    unload_job_t *jobs;
+    u32_t wave;
+    u32_t start;
+    int i, j;
 
     if (sceKernelGetModuleList (0xFF, mod_list, &num_loaded) < 0)
     {
         LOG ("Failed to get module list.");
         return -1;
     }
+    block = sceKernelAllocMemBlock ("UVLCleanup", 0xC20D060, (num_loaded * sizeof (unload_job_t) + 0xFFF) & ~0xFFF, NULL);
+    if (block < 0 || sceKernelGetMemBlockBase (block, (void**)&jobs) < 0)
+    {
+        LOG ("Cannot allocate unload jobs.");
+        return -1;
+    }
     for (i = 0; i < num_loaded; i++)
     {
-       if (sceKernelStopUnloadModule (mod_list[i], 0, NULL, &status, NULL) < 0)
-       {
-            LOG ("Failed to unload module %X, continuing...", mod_list[i]);
-            continue;
-       }
+        uvl_unload_job_init (&jobs[i], mod_list[i]);
+    }
+    for (i = 0; i < num_loaded; i++)
+    {
+        for (j = 0; j < num_loaded; j++)
+        {
+            if (uvl_unload_job_depends (&jobs[j], &jobs[i]))
+            {
+                jobs[i].dependents++;
+            }
+        }
+    }
+
+    start = sceKernelGetSystemTimeLow ();
+    wave = uvl_unload_jobs (jobs, num_loaded);
+
+    for (i = 0; i < num_loaded; i++)
+    {
+        if (jobs[i].result < 0)
+        {
+            LOG ("Failed to unload module %X (%s): 0x%08X", jobs[i].modid, jobs[i].name, jobs[i].result);
+        }
+        else
+        {
+            IF_DEBUG LOG ("Unloaded module %X (%s) in %u us.", jobs[i].modid, jobs[i].name, jobs[i].time);
+        }
+    }
+    IF_DEBUG LOG ("Unloaded %u modules in %u waves, %u us.", num_loaded, wave, sceKernelGetSystemTimeLow () - start);
+    if (sceKernelFreeMemBlock (block) < 0)
+    {
+        LOG ("Cannot free unload jobs.");
     }
     return 0;
 }
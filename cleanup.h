@@ -10,6 +10,10 @@
 
 #include "types.h"
 
+#define MAX_MODULE_LIBS             32  ///< Maximum number of libraries tracked per module when unloading
+#define UVL_UNLOAD_MAX_THREADS      8   ///< Maximum number of modules unloaded at the same time
+#define UVL_UNLOAD_STACK_SIZE       0x4000  ///< Stack of each unload worker, module stop functions run on it
+
 int uvl_cleanup_memory ();
 int uvl_unload_all_modules ();
 
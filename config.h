@@ -8,6 +8,11 @@
 
 #define UVL_HOMEBREW_PATH               ""     ///< Where to load the homebrew.
 #define UVL_LOG_PATH                    ""      ///< Where to load the homebrew.
+#define UVL_LOG_CONSOLE                 0       ///< Draw the log over the game's framebuffer, 1 to enable.
+#define UVL_CATALOG_DIR                 ""      ///< Directory of homebrew to list in the catalog, empty to disable.
+#define UVL_CATALOG_PATH                ""      ///< Where to keep the catalog index.
+#define UVL_SNAPSHOT_PATH               ""      ///< Where to keep syscalls for later launches in the same boot, empty to disable.
+#define UVL_BENCH_PATH                  ""      ///< Where to write benchmark results.
 
 #endif
 /// @}
@@ -0,0 +1,320 @@
+/*
+ * console.c - Debug console drawn to a framebuffer
+ * Copyright 2012 Yifan Lu
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "console.h"
+#include "utils.h"
+
+/** 8x8 font from the IBM PC BIOS, public domain. 
+ *  One byte per line, lowest bit is the left pixel. */
+static const u8_t g_console_font[CONSOLE_NUM_GLYPHS][CONSOLE_GLYPH_SIZE] =
+{
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // space
+    {0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00}, // !
+    {0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // "
+    {0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00}, // #
+    {0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00}, // $
+    {0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00}, // %
+    {0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00}, // &
+    {0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00}, // '
+    {0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00}, // (
+    {0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00}, // )
+    {0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00}, // *
+    {0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00}, // +
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06}, // ,
+    {0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00}, // -
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00}, // .
+    {0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00}, // /
+    {0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00}, // 0
+    {0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00}, // 1
+    {0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00}, // 2
+    {0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00}, // 3
+    {0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00}, // 4
+    {0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00}, // 5
+    {0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00}, // 6
+    {0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00}, // 7
+    {0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00}, // 8
+    {0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00}, // 9
+    {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00}, // :
+    {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06}, // ;
+    {0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00}, // <
+    {0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00}, // =
+    {0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00}, // >
+    {0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00}, // ?
+    {0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00}, // @
+    {0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00}, // A
+    {0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00}, // B
+    {0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00}, // C
+    {0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00}, // D
+    {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00}, // E
+    {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00}, // F
+    {0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00}, // G
+    {0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00}, // H
+    {0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, // I
+    {0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00}, // J
+    {0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00}, // K
+    {0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00}, // L
+    {0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00}, // M
+    {0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00}, // N
+    {0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00}, // O
+    {0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00}, // P
+    {0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00}, // Q
+    {0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00}, // R
+    {0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00}, // S
+    {0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, // T
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00}, // U
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00}, // V
+    {0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00}, // W
+    {0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00}, // X
+    {0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00}, // Y
+    {0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00}, // Z
+    {0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00}, // [
+    {0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00}, // backslash
+    {0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00}, // ]
+    {0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00}, // ^
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF}, // _
+    {0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00}, // `
+    {0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00}, // a
+    {0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00}, // b
+    {0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00}, // c
+    {0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00}, // d
+    {0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00}, // e
+    {0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00}, // f
+    {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F}, // g
+    {0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00}, // h
+    {0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, // i
+    {0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E}, // j
+    {0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00}, // k
+    {0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, // l
+    {0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00}, // m
+    {0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00}, // n
+    {0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00}, // o
+    {0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F}, // p
+    {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78}, // q
+    {0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00}, // r
+    {0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00}, // s
+    {0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00}, // t
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00}, // u
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00}, // v
+    {0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00}, // w
+    {0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00}, // x
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F}, // y
+    {0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00}, // z
+    {0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00}, // {
+    {0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00}, // |
+    {0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00}, // }
+    {0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ~
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // DEL
+};
+
+/********************************************//**
+ *  \brief Sets up a console
+ *  
+ *  Expands every glyph to pixels so drawing 
+ *  is only copying words. The whole screen is 
+ *  marked to be cleared on the next flush.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_console_init (console_t *console,   ///< Console to set up
+                      u32_t *base,      ///< Framebuffer, 32 bits per pixel
+                      u32_t width,      ///< Width in pixels
+                      u32_t height,     ///< Height in pixels
+                      u32_t pitch,      ///< Pixels per framebuffer line
+                      u32_t fg,         ///< Text color
+                      u32_t bg)         ///< Background color
+{
+    u32_t i, y, x;
+
+    console->base = base;
+    console->pitch = pitch;
+    console->cols = width >> CONSOLE_GLYPH_SHIFT;
+    console->rows = height >> CONSOLE_GLYPH_SHIFT;
+    if (console->cols == 0 || console->rows == 0)
+    {
+        return -1;
+    }
+    if (console->cols > CONSOLE_MAX_COLS)
+    {
+        console->cols = CONSOLE_MAX_COLS;
+    }
+    if (console->rows > CONSOLE_MAX_ROWS)
+    {
+        console->rows = CONSOLE_MAX_ROWS;
+    }
+    console->row = 0;
+    console->col = 0;
+    console->wrapped = 0;
+    console->last_flush = 0;
+    for (i = 0; i < CONSOLE_NUM_GLYPHS; i++)
+    {
+        for (y = 0; y < CONSOLE_GLYPH_SIZE; y++)
+        {
+            for (x = 0; x < CONSOLE_GLYPH_SIZE; x++)
+            {
+                console->glyphs[i][y][x] = (g_console_font[i][y] >> x) & 1 ? fg : bg;
+            }
+        }
+    }
+    memset (console->text, ' ', sizeof (console->text));
+    for (i = 0; i < console->rows; i++)
+    {
+        console->dirty_lo[i] = 0;
+        console->dirty_hi[i] = console->cols;
+    }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Starts a new line
+ *  
+ *  Once the screen is full, the new line takes 
+ *  the oldest line's row, which is cleared. 
+ *  No other row moves.
+ ***********************************************/
+static void
+uvl_console_newline (console_t *console)    ///< Console
+{
+    console->col = 0;
+    if (++console->row == console->rows)
+    {
+        console->row = 0;
+        console->wrapped = 1;
+    }
+    if (console->wrapped)
+    {
+        memset (console->text[console->row], ' ', console->cols);
+        console->dirty_lo[console->row] = 0;
+        console->dirty_hi[console->row] = console->cols;
+    }
+}
+
+/********************************************//**
+ *  \brief Writes text to the console
+ *  
+ *  Only changes the text and marks what 
+ *  changed. Nothing is drawn until 
+ *  uvl_console_flush().
+ ***********************************************/
+void
+uvl_console_print (console_t *console,  ///< Console
+                  const char *str)      ///< Text to write
+{
+    u32_t row;
+
+    for (; *str != '\0'; str++)
+    {
+        if (*str == '\n')
+        {
+            uvl_console_newline (console);
+            continue;
+        }
+        if (console->col == console->cols)
+        {
+            uvl_console_newline (console);
+        }
+        row = console->row;
+        console->text[row][console->col] = *str;
+        if (console->dirty_lo[row] == console->dirty_hi[row])
+        {
+            console->dirty_lo[row] = console->col;
+            console->dirty_hi[row] = console->col + 1;
+        }
+        else if (console->col < console->dirty_lo[row])
+        {
+            console->dirty_lo[row] = console->col;
+        }
+        else if (console->col >= console->dirty_hi[row])
+        {
+            console->dirty_hi[row] = console->col + 1;
+        }
+        console->col++;
+    }
+}
+
+/********************************************//**
+ *  \brief Draws one character
+ ***********************************************/
+static inline void
+uvl_console_draw_char (console_t *console,  ///< Console
+                            u32_t row,      ///< Text row
+                            u32_t col,      ///< Text column
+                             char c)        ///< Character to draw
+{
+    u32_t *dst;
+    const u32_t *src;
+    u32_t y;
+
+    c -= CONSOLE_FIRST_CHAR;
+    if ((u8_t)c >= CONSOLE_NUM_GLYPHS)
+    {
+        c = 0;
+    }
+    src = &console->glyphs[(u8_t)c][0][0];
+    dst = &console->base[((row * console->pitch + col) << CONSOLE_GLYPH_SHIFT)];
+    for (y = 0; y < CONSOLE_GLYPH_SIZE; y++)
+    {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = src[3];
+        dst[4] = src[4];
+        dst[5] = src[5];
+        dst[6] = src[6];
+        dst[7] = src[7];
+        src += CONSOLE_GLYPH_SIZE;
+        dst += console->pitch;
+    }
+}
+
+/********************************************//**
+ *  \brief Draws what changed since the last 
+ *  flush
+ *  
+ *  Unless @a force is set, nothing is drawn if 
+ *  the last flush was less than a frame ago. 
+ *  Changes are kept for the next flush. Only 
+ *  the changed columns of each row are drawn.
+ *  \returns Number of rows drawn
+ ***********************************************/
+int
+uvl_console_flush (console_t *console,  ///< Console
+                       u32_t now,       ///< Current time in microseconds
+                         int force)     ///< Set to draw even if too soon
+{
+    u32_t row, col;
+    int drawn;
+
+    if (!force && now - console->last_flush < CONSOLE_FLUSH_INTERVAL)
+    {
+        return 0;
+    }
+    drawn = 0;
+    for (row = 0; row < console->rows; row++)
+    {
+        if (console->dirty_lo[row] == console->dirty_hi[row])
+        {
+            continue;
+        }
+        for (col = console->dirty_lo[row]; col < console->dirty_hi[row]; col++)
+        {
+            uvl_console_draw_char (console, row, col, console->text[row][col]);
+        }
+        console->dirty_lo[row] = console->dirty_hi[row] = 0;
+        drawn++;
+    }
+    console->last_flush = now;
+    return drawn;
+}
@@ -0,0 +1,56 @@
+/// 
+/// \file console.h
+/// \brief Framebuffer debug console
+/// \defgroup console Debug Console
+/// \brief Draws the log on screen
+/// @{
+/// 
+#ifndef UVL_CONSOLE
+#define UVL_CONSOLE
+
+#include "types.h"
+
+#define CONSOLE_GLYPH_SIZE      8       ///< Glyphs are 8x8 pixels
+#define CONSOLE_GLYPH_SHIFT     3       ///< log2 of @c CONSOLE_GLYPH_SIZE
+#define CONSOLE_FIRST_CHAR      0x20    ///< First character in the font
+#define CONSOLE_NUM_GLYPHS      0x60    ///< Characters in the font, others are drawn as spaces
+#define CONSOLE_MAX_COLS        120     ///< Columns of a 960 pixel wide screen
+#define CONSOLE_MAX_ROWS        68      ///< Rows of a 544 pixel high screen
+#define CONSOLE_FLUSH_INTERVAL  16667   ///< Microseconds between redraws, one frame at 60Hz
+
+/**
+ * \brief Debug console
+ * 
+ * Text rows are a ring and each is always 
+ * drawn at the same screen row. Once the 
+ * screen is full, the newest line replaces 
+ * the oldest in place, so nothing scrolls 
+ * and only the new row is redrawn. The caller 
+ * provides the memory, about 33KB.
+ */
+typedef struct console
+{
+    u32_t   *base;                  ///< Framebuffer, 32 bits per pixel
+    u32_t   pitch;                  ///< Framebuffer pixels per line
+    u32_t   cols;                   ///< Text columns
+    u32_t   rows;                   ///< Text rows
+    u32_t   row;                    ///< Row being written
+    u32_t   col;                    ///< Column being written
+    u32_t   wrapped;                ///< Set once a line replaced an older one
+    u32_t   last_flush;             ///< Time of the last redraw
+    u8_t    dirty_lo[CONSOLE_MAX_ROWS];                 ///< First changed column of each row
+    u8_t    dirty_hi[CONSOLE_MAX_ROWS];                 ///< One past the last changed column, equal to @c dirty_lo if clean
+    char    text[CONSOLE_MAX_ROWS][CONSOLE_MAX_COLS];   ///< Characters on screen
+    /**
+     * \brief Glyphs expanded to pixels in the 
+     * console's colors
+     */
+    u32_t   glyphs[CONSOLE_NUM_GLYPHS][CONSOLE_GLYPH_SIZE][CONSOLE_GLYPH_SIZE];
+} console_t;
+
+int uvl_console_init (console_t *console, u32_t *base, u32_t width, u32_t height, u32_t pitch, u32_t fg, u32_t bg);
+void uvl_console_print (console_t *console, const char *str);
+int uvl_console_flush (console_t *console, u32_t now, int force);
+
+#endif
+/// @}
@@ -77,7 +77,7 @@ uvl_load_file (const char *filename,    ///< File to load
  *  
  *  \returns Zero on success, otherwise error
  ***********************************************/
-static inline int
+int
 uvl_free_data (void *data)      ///< Data allocated by @c uvl_load_file
 {
     PsvUID block;
@@ -96,245 +96,1250 @@ uvl_free_data (void *data)      ///< Data allocated by @c uvl_load_file
 }
 
 /********************************************//**
- *  \brief Loads an supported executable
+ *  \brief Reads from a file until @a size bytes 
+ *  are read
+ *  
+ *  If @a crc is given, the file is read in 
+ *  chunks and each chunk is checksummed right 
+ *  after it is read, while it is still cached.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+static int
+uvl_load_read (PsvUID fd,       ///< File to read from
+                 void *buffer,  ///< Where to read to
+                u32_t size,     ///< Bytes to read
+                u32_t *crc)     ///< CRC to update, can be NULL
+{
+    PsvSSize read;
+
+    while (size > 0)
+    {
+        read = sceIoRead (fd, buffer, (crc != NULL && size > UVL_READ_CHUNK) ? UVL_READ_CHUNK : size);
+        if (read <= 0)
+        {
+            LOG ("Read failed with %u bytes left: 0x%08X", size, read);
+            return -1;
+        }
+        if (crc != NULL)
+        {
+            *crc = crc32 (*crc, buffer, read);
+        }
+        buffer = (void*)((u32_t)buffer + read);
+        size -= read;
+    }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Reads the expected checksum of an 
+ *  executable
+ *  
+ *  The checksum is stored in a file next to 
+ *  the executable with @c UVL_CHECKSUM_EXT 
+ *  added to its name. It is the CRC-32 of the 
+ *  file data of every loadable segment, in 
+ *  program header order, as a little endian 
+ *  32-bit word.
+ *  \returns Zero if found, otherwise there is 
+ *  nothing to verify
+ ***********************************************/
+static int
+uvl_load_checksum (const char *filename,    ///< Executable path
+                        u32_t *checksum)    ///< Returned checksum
+{
+    char path[MAX_PATH_LENGTH];
+    PsvUID fd;
+    PsvSSize read;
+
+    if (strlen (filename) + strlen (UVL_CHECKSUM_EXT) >= MAX_PATH_LENGTH)
+    {
+        return -1;
+    }
+    sprintf (path, "%s%s", filename, UVL_CHECKSUM_EXT);
+    fd = sceIoOpen (path, PSP2_O_RDONLY, 0);
+    if (fd < 0)
+    {
+        IF_DEBUG LOG ("No checksum at %s, not verifying.", path);
+        return -1;
+    }
+    read = sceIoRead (fd, checksum, sizeof (u32_t));
+    sceIoClose (fd);
+    if (read != sizeof (u32_t))
+    {
+        LOG ("Invalid checksum file %s, not verifying.", path);
+        return -1;
+    }
+    IF_DEBUG LOG ("Expecting checksum 0x%08X", *checksum);
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Compares checksum of loaded segments
+ *  
+ *  \returns Zero if they match or there is no 
+ *  checksum, otherwise error
+ ***********************************************/
+static inline int
+uvl_load_verify (u32_t *checksum,   ///< Expected checksum, can be NULL
+                 u32_t crc)         ///< Checksum of loaded segments
+{
+    if (checksum == NULL)
+    {
+        return 0;
+    }
+    if (*checksum != crc)
+    {
+        LOG ("Checksum mismatch, expected 0x%08X but loaded 0x%08X. Homebrew is corrupted.", *checksum, crc);
+        return -1;
+    }
+    IF_DEBUG LOG ("Checksum 0x%08X verified.", crc);
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Loads an supported executable
+ *  
+ *  This function identifies and loads a 
+ *  executable at the given file.
+ *  Currently supports ELF and SCE executable.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_load_exe (const char *filename, ///< Absolute path to executable
+                    void **entry)   ///< Returned pointer to entry pointer
+{
+    void *data;
+    PsvSSize size;
+    PsvUID fd;
+    char magic[MAGIC_LEN];
+    u32_t checksum;
+    u32_t *verify;
+    int ret;
+
+    *entry = NULL;
+    IF_DEBUG LOG ("Opening %s for reading.", filename);
+    fd = sceIoOpen (filename, PSP2_O_RDONLY, 0);
+    if (fd < 0)
+    {
+        LOG ("Failed to open %s for reading.", filename);
+        return -1;
+    }
+    if (sceIoRead (fd, magic, MAGIC_LEN) < MAGIC_LEN)
+    {
+        LOG ("Cannot read magic.");
+        sceIoClose (fd);
+        return -1;
+    }
+    IF_VERBOSE LOG ("Magic number: 0x%02X 0x%02X 0x%02X 0x%02X", magic[0], magic[1], magic[2], magic[3]);
+    verify = (uvl_load_checksum (filename, &checksum) < 0) ? NULL : &checksum;
+
+    if (magic[0] == SCEMAG0 && magic[1] == SCEMAG1 && magic[2] == SCEMAG2 && magic[3] == SCEMAG3)
+    {
+        IF_DEBUG LOG ("Loading SELF.");
+        ret = uvl_load_self (fd, verify, entry);
+        if (sceIoClose (fd) < 0)
+        {
+            LOG ("Failed to close file.");
+            return -1;
+        }
+        if (ret < 0)
+        {
+            LOG ("Cannot load SELF.");
+            return -1;
+        }
+        return 0;
+    }
+    if (sceIoClose (fd) < 0)
+    {
+        LOG ("Failed to close file.");
+        return -1;
+    }
+    if (!(magic[0] == ELFMAG0 && magic[1] == ELFMAG1 && magic[2] == ELFMAG2 && magic[3] == ELFMAG3))
+    {
+        LOG ("Invalid magic.");
+        return -1;
+    }
+
+    IF_DEBUG LOG ("Found a ELF, loading.");
+    if (uvl_load_file (filename, &data, &size) < 0)
+    {
+        LOG ("Cannot load file.");
+        return -1;
+    }
+    if (uvl_load_elf (data, size, verify, entry) < 0)
+    {
+        LOG ("Cannot load ELF.");
+        return -1;
+    }
+
+    // free data
+    if (uvl_free_data (data) < 0)
+    {
+        LOG ("Cannot free data");
+        return -1;
+    }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Loads the segments of a SELF
+ *  
+ *  Reads the complete SCE header to @a header 
+ *  and streams each segment from the file to 
+ *  where it is loaded.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+static int
+uvl_load_self_segments (PsvUID fd,              ///< Opened SELF file
+                  sce_header_t *sce_hdr,        ///< SCE header already read
+                          void *header,         ///< Buffer for the complete SCE header
+                         u32_t *checksum,       ///< Expected checksum of segments, NULL to skip
+                          void **base,          ///< Returned block of the segment with module info
+                 module_info_t **mod_info)      ///< Returned module info
+{
+    u32_t header_len;
+    Elf32_Ehdr_t *elf_hdr;
+    Elf32_Phdr_t *prog_hdrs;
+    sce_segment_info_t *seg_infos;
+    void *blockaddr;
+    u32_t base_index;
+    u32_t crc;
+    u32_t i;
+    int zeroed;
+
+    // read the complete header, the ELF header and tables are inside it
+    header_len = (u32_t)sce_hdr->header_len;
+    if (sceIoLseek (fd, (u64_t)0, PSP2_SEEK_SET) < 0 || uvl_load_read (fd, header, header_len, NULL) < 0)
+    {
+        LOG ("Cannot read SCE header.");
+        return -1;
+    }
+    if ((u32_t)sce_hdr->elf_offset + sizeof (Elf32_Ehdr_t) > header_len)
+    {
+        LOG ("ELF header is outside of SCE header.");
+        return -1;
+    }
+    elf_hdr = (void*)((u32_t)header + (u32_t)sce_hdr->elf_offset);
+    IF_DEBUG LOG ("Checking headers.");
+    if (uvl_elf_check_header (elf_hdr) < 0)
+    {
+        LOG ("Check header failed.");
+        return -1;
+    }
+    if (elf_hdr->e_phnum < 1)
+    {
+        LOG ("No program sections to load!");
+        return -1;
+    }
+    if ((u32_t)sce_hdr->phdr_offset + elf_hdr->e_phnum * sizeof (Elf32_Phdr_t) > header_len || 
+        (u32_t)sce_hdr->section_info_offset + elf_hdr->e_phnum * sizeof (sce_segment_info_t) > header_len)
+    {
+        LOG ("Program headers are outside of SCE header.");
+        return -1;
+    }
+    prog_hdrs = (void*)((u32_t)header + (u32_t)sce_hdr->phdr_offset);
+    seg_infos = (void*)((u32_t)header + (u32_t)sce_hdr->section_info_offset);
+
+    // free memory
+    IF_DEBUG LOG ("Cleaning up memory.");
+    if (uvl_elf_free_memory (prog_hdrs, elf_hdr->e_phnum) < 0)
+    {
+        LOG ("Error freeing memory.");
+        return -1;
+    }
+
+    // stream each segment to its block
+    *base = NULL;
+    base_index = 0;
+    crc = 0;
+    IF_DEBUG LOG ("Loading %u program sections.", elf_hdr->e_phnum);
+    for (i = 0; i < elf_hdr->e_phnum; i++)
+    {
+        if (prog_hdrs[i].p_type != PT_LOAD || prog_hdrs[i].p_vaddr == 0)
+        {
+            IF_DEBUG LOG ("Section %u is not loadable. Skipping.", i);
+            continue;
+        }
+        if (seg_infos[i].encryption == SCE_SEGMENT_ENCRYPTED)
+        {
+            LOG ("Section %u is encrypted.", i);
+            return -1;
+        }
+        if (seg_infos[i].compression == SCE_SEGMENT_COMPRESSED)
+        {
+            LOG ("Section %u is compressed, which is not supported.", i);
+            return -1;
+        }
+        if (uvl_elf_alloc_segment (&prog_hdrs[i], i, &blockaddr) < 0)
+        {
+            return -1;
+        }
+        if (*base == NULL)
+        {
+            *base = blockaddr;
+            base_index = i;
+        }
+        zeroed = uvl_mem_fresh_is_zero (UVL_SEGMENT_MEM (&prog_hdrs[i]));
+        IF_DEBUG LOG ("Reading %u bytes at 0x%X to section %u.", prog_hdrs[i].p_filesz, (u32_t)seg_infos[i].offset, i);
+        if (sceIoLseek (fd, seg_infos[i].offset, PSP2_SEEK_SET) < 0)
+        {
+            LOG ("Cannot seek to section %u.", i);
+            return -1;
+        }
+        psvUnlockMem ();
+        if (uvl_load_read (fd, blockaddr, prog_hdrs[i].p_filesz, checksum != NULL ? &crc : NULL) < 0)
+        {
+            psvLockMem ();
+            LOG ("Cannot read section %u.", i);
+            return -1;
+        }
+        uvl_elf_zero_bss ((void*)((u32_t)blockaddr + prog_hdrs[i].p_filesz), prog_hdrs[i].p_memsz - prog_hdrs[i].p_filesz, zeroed);
+        psvLockMem ();
+    }
+    if (*base == NULL)
+    {
+        LOG ("No loadable sections.");
+        return -1;
+    }
+    if (uvl_load_verify (checksum, crc) < 0)
+    {
+        return -1;
+    }
+
+    // section headers are not in the SCE header, module info is in the segment loaded first
+    if (uvl_elf_get_module_info_offset (&prog_hdrs[base_index], &i) < 0)
+    {
+        LOG ("Cannot find module info.");
+        return -1;
+    }
+    *mod_info = (void*)((u32_t)*base + i);
+    IF_DEBUG LOG ("Module name: %s, export table offset: 0x%08X, import table offset: 0x%08X", (*mod_info)->modname, (*mod_info)->ent_top, (*mod_info)->stub_top);
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Loads a SELF file
+ *  
+ *  Only the SCE header is read to memory. Each 
+ *  segment is then read from the file directly 
+ *  to where it is loaded, as described by the 
+ *  segment info table. Encrypted and 
+ *  compressed segments are not supported.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_load_self (PsvUID fd,           ///< Opened SELF file
+                u32_t *checksum,    ///< Expected checksum of segments, NULL to skip
+                 void **entry)      ///< Returned pointer to entry pointer
+{
+    sce_header_t sce_hdr;
+    PsvUID memblock;
+    void *header;
+    u32_t header_len;
+    module_info_t *mod_info;
+    void *base;
+    int ret;
+
+    *entry = NULL;
+    IF_VERBOSE LOG ("Reading SCE header.");
+    if (sceIoLseek (fd, (u64_t)0, PSP2_SEEK_SET) < 0 || uvl_load_read (fd, &sce_hdr, sizeof (sce_hdr), NULL) < 0)
+    {
+        LOG ("Cannot read SCE header.");
+        return -1;
+    }
+    if (sce_hdr.header_type != SCE_TYPE_SELF)
+    {
+        LOG ("SCE file type %u is not a SELF.", sce_hdr.header_type);
+        return -1;
+    }
+    header_len = (u32_t)sce_hdr.header_len;
+    IF_DEBUG LOG ("SCE header length: 0x%X, ELF at 0x%X, program headers at 0x%X, segment info at 0x%X", header_len, (u32_t)sce_hdr.elf_offset, (u32_t)sce_hdr.phdr_offset, (u32_t)sce_hdr.section_info_offset);
+    if (header_len < sizeof (sce_hdr) || header_len > UVL_BIN_MAX_SIZE)
+    {
+        LOG ("Invalid SCE header length 0x%X.", header_len);
+        return -1;
+    }
+
+    memblock = sceKernelAllocMemBlock ("UVLTemp", 0xC20D060, (header_len + 0xFFF) & ~0xFFF, NULL);
+    if (memblock < 0)
+    {
+        LOG ("Failed allocate %u bytes of memory.", header_len);
+        return -1;
+    }
+    if (sceKernelGetMemBlockBase (memblock, &header) < 0)
+    {
+        LOG ("Failed to locate base for block 0x%08X.", memblock);
+        sceKernelFreeMemBlock (memblock);
+        return -1;
+    }
+    ret = uvl_load_self_segments (fd, &sce_hdr, header, checksum, &base, &mod_info);
+
+    // header no longer needed
+    if (sceKernelFreeMemBlock (memblock) < 0)
+    {
+        LOG ("Cannot free header");
+        return -1;
+    }
+    if (ret < 0)
+    {
+        return -1;
+    }
+
+    return uvl_elf_link (base, mod_info, NULL, entry);
+}
+
+/********************************************//**
+ *  \brief Finds where a loaded address is in 
+ *  the file
+ *  
+ *  The address is translated through the 
+ *  loadable segment that contains it, so 
+ *  segments may be laid out in the file 
+ *  differently than in memory.
+ *  \returns Pointer into the file, or NULL if 
+ *  the range is not in the file part of one 
+ *  loadable segment
+ ***********************************************/
+void *
+uvl_elf_vaddr_to_file (elf_file_t *file,    ///< ELF read to memory
+                            u32_t addr,     ///< Loaded address
+                            u32_t length)   ///< Length of range
+{
+    Elf32_Phdr_t *prog_hdr;
+    u32_t i;
+
+    for (i = 0; i < file->count; i++)
+    {
+        prog_hdr = &file->prog_hdrs[i];
+        if (prog_hdr->p_type == PT_LOAD && prog_hdr->p_vaddr != 0 && addr >= (u32_t)prog_hdr->p_vaddr && addr + length <= (u32_t)prog_hdr->p_vaddr + prog_hdr->p_filesz)
+        {
+            return (void*)((u32_t)file->data + prog_hdr->p_offset + addr - (u32_t)prog_hdr->p_vaddr);
+        }
+    }
+    return NULL;
+}
+
+/********************************************//**
+ *  \brief Finds the loaded address of a 
+ *  pointer into the file
+ *  
+ *  \returns Loaded address, or zero if the 
+ *  pointer is not in a loadable segment
+ ***********************************************/
+static u32_t
+uvl_elf_file_to_vaddr (elf_file_t *file,    ///< ELF read to memory
+                             void *ptr)     ///< Pointer into the file
+{
+    Elf32_Phdr_t *prog_hdr;
+    u32_t offset;
+    u32_t i;
+
+    offset = (u32_t)ptr - (u32_t)file->data;
+    for (i = 0; i < file->count; i++)
+    {
+        prog_hdr = &file->prog_hdrs[i];
+        if (prog_hdr->p_type == PT_LOAD && prog_hdr->p_vaddr != 0 && offset >= prog_hdr->p_offset && offset < prog_hdr->p_offset + prog_hdr->p_filesz)
+        {
+            return (u32_t)prog_hdr->p_vaddr + offset - prog_hdr->p_offset;
+        }
+    }
+    return 0;
+}
+
+/** Translates a loaded pointer to the file, or back */
+#define UVL_FILE_PTR(file, ptr, to_file) \
+    ((to_file) ? uvl_elf_vaddr_to_file ((file), (u32_t)(ptr), 1) : (void*)uvl_elf_file_to_vaddr ((file), (ptr)))
+
+/********************************************//**
+ *  \brief Changes import table's pointers 
+ *  to loaded file in memory, or back.
+ *  
+ *  This is only used when NIDs needs to be 
+ *  resolved before the program is loaded to 
+ *  it's proper location. The entry tables are 
+ *  always edited in the file. Every pointer 
+ *  must have been checked with 
+ *  @c uvl_elf_import_in_file.
+ ***********************************************/
+static inline void
+uvl_offset_import (module_imports_t *import,   ///< Import table to modify
+                         elf_file_t *file,     ///< ELF read to memory
+                                int to_file)   ///< Set to point to the file, clear to point back to loaded addresses
+{
+    void **func_entries;
+    void **var_entries;
+    void **tls_entries;
+    int i;
+    func_entries = to_file ? uvl_elf_vaddr_to_file (file, (u32_t)import->func_entry_table, 0) : (void*)import->func_entry_table;
+    var_entries = to_file ? uvl_elf_vaddr_to_file (file, (u32_t)import->var_entry_table, 0) : (void*)import->var_entry_table;
+    tls_entries = to_file ? uvl_elf_vaddr_to_file (file, (u32_t)import->tls_entry_table, 0) : (void*)import->tls_entry_table;
+    IF_VERBOSE LOG ("Modifying import table entries offsets for 0x%08X", (u32_t)import);
+    for (i = 0; i < import->num_functions; i++)
+    {
+        func_entries[i] = UVL_FILE_PTR (file, func_entries[i], to_file);
+    }
+    for (i = 0; i < import->num_vars; i++)
+    {
+        var_entries[i] = UVL_FILE_PTR (file, var_entries[i], to_file);
+    }
+    for (i = 0; i < import->num_tls_vars; i++)
+    {
+        tls_entries[i] = UVL_FILE_PTR (file, tls_entries[i], to_file);
+    }
+    IF_VERBOSE LOG ("Modifying import table offsets for 0x%08X", (u32_t)import);
+    import->lib_name = UVL_FILE_PTR (file, import->lib_name, to_file);
+    import->func_nid_table = import->num_functions > 0 ? UVL_FILE_PTR (file, import->func_nid_table, to_file) : import->func_nid_table;
+    import->func_entry_table = import->num_functions > 0 ? UVL_FILE_PTR (file, import->func_entry_table, to_file) : import->func_entry_table;
+    import->var_nid_table = import->num_vars > 0 ? UVL_FILE_PTR (file, import->var_nid_table, to_file) : import->var_nid_table;
+    import->var_entry_table = import->num_vars > 0 ? UVL_FILE_PTR (file, import->var_entry_table, to_file) : import->var_entry_table;
+    import->tls_nid_table = import->num_tls_vars > 0 ? UVL_FILE_PTR (file, import->tls_nid_table, to_file) : import->tls_nid_table;
+    import->tls_entry_table = import->num_tls_vars > 0 ? UVL_FILE_PTR (file, import->tls_entry_table, to_file) : import->tls_entry_table;
+}
+
+/********************************************//**
+ *  \brief Checks that every array of an 
+ *  import table is in the file
+ *  
+ *  \returns One if it is, otherwise zero
+ ***********************************************/
+static int
+uvl_elf_import_arrays_in_file (elf_file_t *file,        ///< ELF read to memory
+                         module_imports_t *import)      ///< Import table in the file
+{
+    return uvl_elf_vaddr_to_file (file, (u32_t)import->lib_name, 1) != NULL &&
+        (import->num_functions == 0 || 
+            (uvl_elf_vaddr_to_file (file, (u32_t)import->func_nid_table, import->num_functions * sizeof (u32_t)) != NULL &&
+             uvl_elf_vaddr_to_file (file, (u32_t)import->func_entry_table, import->num_functions * sizeof (void*)) != NULL)) &&
+        (import->num_vars == 0 || 
+            (uvl_elf_vaddr_to_file (file, (u32_t)import->var_nid_table, import->num_vars * sizeof (u32_t)) != NULL &&
+             uvl_elf_vaddr_to_file (file, (u32_t)import->var_entry_table, import->num_vars * sizeof (void*)) != NULL)) &&
+        (import->num_tls_vars == 0 || 
+            (uvl_elf_vaddr_to_file (file, (u32_t)import->tls_nid_table, import->num_tls_vars * sizeof (u32_t)) != NULL &&
+             uvl_elf_vaddr_to_file (file, (u32_t)import->tls_entry_table, import->num_tls_vars * sizeof (void*)) != NULL));
+}
+
+/********************************************//**
+ *  \brief Checks if imports can be resolved 
+ *  in the file
+ *  
+ *  Every import table, its arrays, and every 
+ *  stub and imported variable must be in the 
+ *  file part of a loadable segment. Each is 
+ *  found through its own segment. Modules 
+ *  exporting libraries are resolved after 
+ *  loading instead.
+ *  \returns Zero if imports can be resolved 
+ *  in the file, otherwise error
+ ***********************************************/
+static int
+uvl_elf_import_in_file (elf_file_t *file,           ///< ELF read to memory
+                     module_info_t *mod_info)       ///< Module information
+{
+    module_ports_iter_t iter;
+    module_exports_t *export;
+    module_imports_t *import;
+    void **entries;
+    u32_t base;
+    void *start;
+    u32_t j;
+
+    base = (u32_t)file->prog_hdrs[0].p_vaddr;
+    // imports may bind to the module's own libraries, which are added once loaded
+    if ((start = uvl_elf_vaddr_to_file (file, base + mod_info->ent_top, mod_info->ent_end - mod_info->ent_top)) == NULL)
+    {
+        return -1;
+    }
+    uvl_module_ports_begin (&iter, start, (void*)((u32_t)start + mod_info->ent_end - mod_info->ent_top), MODULE_PORTS_EXPORTS, 0);
+    while ((export = (module_exports_t*)uvl_module_ports_next (&iter)) != NULL)
+    {
+        if (export->attribute != ATTR_MOD_INFO)
+        {
+            IF_DEBUG LOG ("Module exports libraries its imports may use.");
+            return -1;
+        }
+    }
+    if ((start = uvl_elf_vaddr_to_file (file, base + mod_info->stub_top, mod_info->stub_end - mod_info->stub_top)) == NULL)
+    {
+        return -1;
+    }
+    uvl_module_ports_begin (&iter, start, (void*)((u32_t)start + mod_info->stub_end - mod_info->stub_top), MODULE_PORTS_IMPORTS, 0);
+    while ((import = (module_imports_t*)uvl_module_ports_next (&iter)) != NULL)
+    {
+        if (!uvl_elf_import_arrays_in_file (file, import))
+        {
+            return -1;
+        }
+        entries = uvl_elf_vaddr_to_file (file, (u32_t)import->func_entry_table, 0);
+        for (j = 0; j < import->num_functions; j++)
+        {
+            if (uvl_elf_vaddr_to_file (file, (u32_t)entries[j], STUB_FUNC_SIZE) == NULL)
+            {
+                return -1;
+            }
+        }
+        entries = uvl_elf_vaddr_to_file (file, (u32_t)import->var_entry_table, 0);
+        for (j = 0; j < import->num_vars; j++)
+        {
+            if (uvl_elf_vaddr_to_file (file, (u32_t)entries[j], 4) == NULL)
+            {
+                return -1;
+            }
+        }
+        entries = uvl_elf_vaddr_to_file (file, (u32_t)import->tls_entry_table, 0);
+        for (j = 0; j < import->num_tls_vars; j++)
+        {
+            if (uvl_elf_vaddr_to_file (file, (u32_t)entries[j], 4) == NULL)
+            {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Loads an ELF file
+ *  
+ *  Performs both loading and resolving NIDs
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int 
+uvl_load_elf (void *data,           ///< ELF data start
+             u32_t size,            ///< Bytes of ELF data
+             u32_t *checksum,       ///< Expected checksum of segments, NULL to skip
+              void **entry)         ///< Returned pointer to entry pointer
+{
+    Elf32_Ehdr_t *elf_hdr;
+    u32_t crc;
+    u32_t i;
+    *entry = NULL;
+
+    // get headers
+    IF_VERBOSE LOG ("Reading headers.");
+    elf_hdr = data;
+    IF_DEBUG LOG ("Checking headers.");
+    if (uvl_elf_check_header (elf_hdr) < 0)
+    {
+        LOG ("Check header failed.");
+        return -1;
+    }
+
+    // get program headers, the first one is the base of every address below
+    Elf32_Phdr_t *prog_hdrs;
+    IF_VERBOSE LOG ("Reading program headers.");
+    if (elf_hdr->e_phnum < 1)
+    {
+        LOG ("No program sections to load!");
+        return -1;
+    }
+    if (elf_hdr->e_phoff > size || elf_hdr->e_phnum * sizeof (Elf32_Phdr_t) > size - elf_hdr->e_phoff)
+    {
+        LOG ("Program headers are outside the file.");
+        return -1;
+    }
+    prog_hdrs = (void*)((u32_t)data + elf_hdr->e_phoff);
+
+    // get mod_info
+    module_info_t *mod_info;
+    IF_DEBUG LOG ("Getting module info.");
+    if (uvl_elf_get_module_info (data, size, elf_hdr, &mod_info) < 0)
+    {
+        LOG ("Cannot find module info section.");
+        return -1;
+    }
+    IF_DEBUG LOG ("Module name: %s, export table offset: 0x%08X, import table offset: 0x%08X", mod_info->modname, mod_info->ent_top, mod_info->stub_top);
+
+    // free memory
+    IF_DEBUG LOG ("Cleaning up memory.");
+    if (uvl_elf_free_memory (prog_hdrs, elf_hdr->e_phnum) < 0)
+    {
+        LOG ("Error freeing memory.");
+        return -1;
+    }
+
+    // optional, linear search without it
+    export_index_t *index;
+    uvl_elf_get_export_index (data, size, elf_hdr, &index);
+
+    // resolve in the file so each segment is written once
+    elf_file_t file;
+    int in_file;
+    file.data = data;
+    file.prog_hdrs = prog_hdrs;
+    file.count = elf_hdr->e_phnum;
+    in_file = (uvl_elf_import_in_file (&file, mod_info) == 0);
+    if (!in_file)
+    {
+        IF_DEBUG LOG ("Cannot resolve imports in file, resolving after loading.");
+    }
+    crc = 0;
+    if (in_file)
+    {
+        // checksum is of the file, not of the resolved stubs, so it 
+        // cannot be computed while copying and costs an extra pass
+        if (checksum != NULL)
+        {
+            for (i = 0; i < elf_hdr->e_phnum; i++)
+            {
+                if (prog_hdrs[i].p_type == PT_LOAD && prog_hdrs[i].p_vaddr != 0)
+                {
+                    crc = crc32 (crc, (void*)((u32_t)data + prog_hdrs[i].p_offset), prog_hdrs[i].p_filesz);
+                }
+            }
+            if (uvl_load_verify (checksum, crc) < 0)
+            {
+                return -1;
+            }
+            checksum = NULL;
+        }
+        IF_DEBUG LOG ("Resolving imports in file.");
+        void *stub_top;
+        stub_top = uvl_elf_vaddr_to_file (&file, (u32_t)prog_hdrs[0].p_vaddr + mod_info->stub_top, 0);
+        if (uvl_elf_resolve_imports (stub_top, (void*)((u32_t)stub_top + mod_info->stub_end - mod_info->stub_top), &file) < 0)
+        {
+            return -1;
+        }
+    }
+
+    // actually load the ELF
+    void *blockaddr;
+    load_work_t work;
+    int need_zero;          // set when the block is not known to be zero filled
+    IF_DEBUG LOG ("Loading %u program sections.", elf_hdr->e_phnum);
+    memset (&work, 0, sizeof (work));
+    for (i = 0; i < elf_hdr->e_phnum; i++)
+    {
+        if (prog_hdrs[i].p_type != PT_LOAD || prog_hdrs[i].p_vaddr == 0)
+        {
+            IF_DEBUG LOG ("Section %u is not loadable. Skipping.", i);
+            continue;
+        }
+        // probed before unlocking, the probe locks memory again
+        need_zero = !uvl_mem_fresh_is_zero (UVL_SEGMENT_MEM (&prog_hdrs[i]));
+        if (uvl_elf_alloc_segment (&prog_hdrs[i], i, &blockaddr) < 0)
+        {
+            return -1;
+        }
+
+        IF_DEBUG LOG ("Allocated memory at 0x%08X, attempting to load section %u.", (u32_t)blockaddr, i);
+        // the checksum is computed in order, so only unchecked segments are split up
+        if (checksum == NULL && uvl_load_work_add (&work, blockaddr, (void*)((u32_t)data + prog_hdrs[i].p_offset), prog_hdrs[i].p_filesz, need_zero ? prog_hdrs[i].p_memsz - prog_hdrs[i].p_filesz : 0) == 0)
+        {
+#ifdef UVL_VERIFY_ZERO
+            if (!need_zero)
+            {
+                psvUnlockMem ();
+                uvl_elf_zero_bss ((void*)((u32_t)blockaddr + prog_hdrs[i].p_filesz), prog_hdrs[i].p_memsz - prog_hdrs[i].p_filesz, 1);
+                psvLockMem ();
+            }
+#endif
+            continue;
+        }
+        psvUnlockMem ();
+        if (checksum != NULL)
+        {
+            crc = crc32_copy (crc, blockaddr, (void*)((u32_t)data + prog_hdrs[i].p_offset), prog_hdrs[i].p_filesz);
+        }
+        else
+        {
+            memcpy (blockaddr, (void*)((u32_t)data + prog_hdrs[i].p_offset), prog_hdrs[i].p_filesz);
+        }
+        uvl_elf_zero_bss ((void*)((u32_t)blockaddr + prog_hdrs[i].p_filesz), prog_hdrs[i].p_memsz - prog_hdrs[i].p_filesz, !need_zero);
+        psvLockMem ();
+    }
+    if (work.num_segments > 0)
+    {
+        IF_DEBUG LOG ("Loading %u bytes of %u sections in %u chunks.", work.bytes, work.num_segments, work.num_chunks);
+        psvUnlockMem ();
+        uvl_load_work_run (&work, work.bytes < UVL_LOAD_PARALLEL_MIN ? 1 : UVL_LOAD_MAX_THREADS);
+        psvLockMem ();
+    }
+    if (uvl_load_verify (checksum, crc) < 0)
+    {
+        return -1;
+    }
+
+    if (in_file)
+    {
+        return uvl_elf_find_entry (prog_hdrs[0].p_vaddr, mod_info, index, entry);
+    }
+    return uvl_elf_link (prog_hdrs[0].p_vaddr, mod_info, index, entry);
+}
+
+/********************************************//**
+ *  \brief Allocates memory for a segment
+ *  
+ *  Executable segments get code memory. The 
+ *  size is rounded up to 1MB.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_elf_alloc_segment (Elf32_Phdr_t *prog_hdr,  ///< Program header of segment
+                              u32_t index,      ///< Index of segment, for logging
+                               void **blockaddr) ///< Returned address of allocated memory
+{
+    PsvUID memblock;
+    u32_t length;
+
+    length = prog_hdr->p_memsz;
+    length = (length + 0xFFFFF) & ~0xFFFFF; // Align to 1MB
+    if ((prog_hdr->p_flags & PF_X) == PF_X) // executable section
+    {
+        memblock = sceKernelAllocCodeMemBlock ("UVLHomebrew", length);
+    }
+    else // data section
+    {
+        memblock = sceKernelAllocMemBlock ("UVLHomebrew", 0xC20D060, length, NULL);
+    }
+    if (memblock < 0)
+    {
+        LOG ("Error allocating memory. 0x%08X", memblock);
+        return -1;
+    }
+    if (sceKernelGetMemBlockBase (memblock, blockaddr) < 0)
+    {
+        LOG ("Error getting memory block address.");
+    }
+    if ((u32_t)*blockaddr != (u32_t)prog_hdr->p_vaddr)
+    {
+        LOG ("Error, section %u wants to be loaded to 0x%08X but we allocated 0x%08X", index, (u32_t)prog_hdr->p_vaddr, (u32_t)*blockaddr);
+        //return -1;
+    }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Adds a segment to be loaded in 
+ *  parallel
+ *  
+ *  The work must be zeroed before the first 
+ *  segment is added.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_load_work_add (load_work_t *work,   ///< Work to add to
+                          void *dst,    ///< Loaded address
+                          void *src,    ///< File data
+                         u32_t copy,    ///< Bytes to copy
+                         u32_t zero)    ///< Bytes to zero after the copy
+{
+    load_segment_t *segment;
+
+    if (work->num_segments >= UVL_LOAD_MAX_SEGMENTS)
+    {
+        return -1;
+    }
+    segment = &work->segments[work->num_segments++];
+    segment->dst = dst;
+    segment->src = src;
+    segment->copy = copy;
+    segment->zero = zero;
+    segment->first = work->num_chunks;
+    work->num_chunks += (copy + zero + UVL_LOAD_CHUNK - 1) >> UVL_LOAD_CHUNK_SHIFT;
+    work->bytes += copy + zero;
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Copies and zeros chunks until none 
+ *  are left
+ *  
+ *  Every worker and the loading thread run 
+ *  this, each taking the next free chunk. Does 
+ *  not log, other threads may be logging.
+ ***********************************************/
+static void
+uvl_load_work_chunks (load_work_t *work)    ///< Work to take chunks from
+{
+    load_segment_t *segment;
+    u32_t chunk;
+    u32_t start, end, from;
+    u32_t i;
+
+    while ((chunk = __sync_fetch_and_add (&work->next, 1)) < work->num_chunks)
+    {
+        // empty segments share their first chunk with the next one
+        i = work->num_segments - 1;
+        while (work->segments[i].first > chunk)
+        {
+            i--;
+        }
+        segment = &work->segments[i];
+        start = (chunk - segment->first) << UVL_LOAD_CHUNK_SHIFT;
+        end = start + UVL_LOAD_CHUNK;
+        if (end > segment->copy + segment->zero)
+        {
+            end = segment->copy + segment->zero;
+        }
+        if (start < segment->copy)
+        {
+            memcpy (&segment->dst[start], &segment->src[start], (end < segment->copy ? end : segment->copy) - start);
+        }
+        if (end > segment->copy)
+        {
+            from = start > segment->copy ? start : segment->copy;
+            memset (&segment->dst[from], 0, end - from);
+        }
+    }
+}
+
+/********************************************//**
+ *  \brief Worker thread that loads chunks
+ *  
+ *  Memory is unlocked for the worker but never 
+ *  locked again here. The loading thread locks 
+ *  it once every worker has joined, so one 
+ *  finishing early cannot lock out the others.
+ *  \returns Zero
+ ***********************************************/
+static int
+uvl_load_thread (u32_t args,    ///< Size of @a argp
+                  void *argp)   ///< Pointer to the @c load_work_t pointer
+{
+    psvUnlockMem ();
+    uvl_load_work_chunks (*(load_work_t**)argp);
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Copies and zeros all added segments
+ *  
+ *  Chunks are shared between @a threads - 1 
+ *  workers and the calling thread, then the 
+ *  workers are joined before returning so the 
+ *  segments are complete. Memory must be 
+ *  unlocked.
+ ***********************************************/
+void
+uvl_load_work_run (load_work_t *work,   ///< Segments to load
+                         u32_t threads) ///< Threads to use, including the caller
+{
+    PsvUID workers[UVL_LOAD_MAX_THREADS];
+    u32_t count;
+    int status;
+    u32_t i;
+
+    count = 0;
+    for (i = 1; i < threads && i < UVL_LOAD_MAX_THREADS && i < work->num_chunks; i++)
+    {
+        workers[count] = sceKernelCreateThread ("uvlload", uvl_load_thread, 0x10000100, 0x00001000, 0, (0x01 << 16 | 0x02 << 16 | 0x04 << 16), NULL);
+        if (workers[count] < 0 || sceKernelStartThread (workers[count], sizeof (load_work_t*), &work) < 0)
+        {
+            IF_DEBUG LOG ("Cannot start load worker, continuing with %u threads.", count + 1);
+            if (workers[count] >= 0)
+            {
+                sceKernelDeleteThread (workers[count]);
+            }
+            break;
+        }
+        count++;
+    }
+    uvl_load_work_chunks (work);
+    for (i = 0; i < count; i++)
+    {
+        sceKernelWaitThreadEnd (workers[i], &status, NULL);
+        sceKernelDeleteThread (workers[i]);
+    }
+}
+
+/** Whether fresh memory blocks of each type are zero, -1 if not probed yet */
+int g_fresh_block_zeroed[UVL_MEM_TYPES] = {-1, -1};
+
+/********************************************//**
+ *  \brief Checks if newly allocated memory 
+ *  blocks of a type are already zero filled
  *  
- *  This function identifies and loads a 
- *  executable at the given file.
- *  Currently supports ELF and SCE executable.
- *  \returns Zero on success, otherwise error
+ *  Allocates a block of @a type the size of a 
+ *  segment and samples a word at the start and 
+ *  end of every page. Code and data blocks come 
+ *  from different allocators, so each type is 
+ *  probed on its own. The result is cached so 
+ *  the probe only runs once per type.
+ *  \returns One if fresh blocks are zero, 
+ *  otherwise zero
  ***********************************************/
 int
-uvl_load_exe (const char *filename, ///< Absolute path to executable
-                    void **entry)   ///< Returned pointer to entry pointer
+uvl_mem_fresh_is_zero (int type)    ///< @c UVL_MEM_DATA or @c UVL_MEM_CODE
 {
-    void *data;
-    PsvSSize size;
-    char *magic;
+    PsvUID block;
+    u32_t *base;
+    u32_t i;
+    int zeroed;
 
-    *entry = NULL;
-    IF_DEBUG LOG ("Opening %s for reading.", filename);
-    if (uvl_load_file (filename, &data, &size) < 0)
+    if (g_fresh_block_zeroed[type] >= 0)
     {
-        LOG ("Cannot load file.");
-        return -1;
+        return g_fresh_block_zeroed[type];
     }
-
-    magic = (char*)data;
-    IF_VERBOSE LOG ("Magic number: 0x%02X 0x%02X 0x%02X 0x%02X", magic[0], magic[1], magic[2], magic[3]);
-
-    if (magic[0] == ELFMAG0)
+    zeroed = 0;
+    if (type == UVL_MEM_CODE)
     {
-        if (magic[1] == ELFMAG1 && magic[2] == ELFMAG2 && magic[3] == ELFMAG3)
-        {
-            IF_DEBUG LOG ("Found a ELF, loading.");
-            if (uvl_load_elf (data, entry) < 0)
-            {
-                LOG ("Cannot load ELF.");
-                return -1;
-            }
-        }
+        block = sceKernelAllocCodeMemBlock ("UVLProbe", UVL_SEC_MIN_ALIGN);
     }
-    else if (magic[0] == SCEMAG0)
+    else
+    {
+        block = sceKernelAllocMemBlock ("UVLProbe", 0xC20D060, UVL_SEC_MIN_ALIGN, NULL);
+    }
+    if (block < 0)
     {
-        if (magic[1] == SCEMAG1 && magic[2] == SCEMAG2 && magic[3] == SCEMAG3)
+        LOG ("Cannot allocate probe block: 0x%08X", block);
+        return 0; // don't cache, try again next time
+    }
+    if (sceKernelGetMemBlockBase (block, (void**)&base) >= 0)
+    {
+        zeroed = 1;
+        for (i = 0; i < UVL_SEC_MIN_ALIGN / sizeof (u32_t); i += UVL_PAGE_SIZE / sizeof (u32_t))
         {
-            IF_DEBUG LOG ("Loading SELF.");
-            if (uvl_load_elf ((void*)((u32_t)data + SCEHDR_LEN), entry) < 0)
+            if (base[i] != 0 || base[i + UVL_PAGE_SIZE / sizeof (u32_t) - 1] != 0)
             {
-                LOG ("Cannot load SELF.");
-                return -1;
+                zeroed = 0;
+                break;
             }
         }
     }
-    else
-    {
-        LOG ("Invalid magic.");
-        return -1;
-    }
-
-    // free data
-    if (uvl_free_data (data) < 0)
+    if (sceKernelFreeMemBlock (block) < 0)
     {
-        LOG ("Cannot free data");
-        return -1;
+        LOG ("Cannot free probe block: 0x%08X", block);
     }
-    return 0;
+    IF_DEBUG LOG ("Fresh %s blocks are %s.", type == UVL_MEM_CODE ? "code" : "data", zeroed ? "zero filled" : "not zero filled");
+    psvUnlockMem ();
+    g_fresh_block_zeroed[type] = zeroed;
+    psvLockMem ();
+    return zeroed;
 }
 
 /********************************************//**
- *  \brief Changes import table's offsets 
- *  to loaded file in memory.
+ *  \brief Zeros the uninitialized part of a 
+ *  segment
  *  
- *  This is only used when NIDs needs to be 
- *  resolved before the program is loaded to 
- *  it's proper location.
+ *  Skipped when the caller knows the memory is 
+ *  already zero, usually because the block was 
+ *  just allocated and @c uvl_mem_fresh_is_zero 
+ *  holds for its type. Builds with 
+ *  @c UVL_VERIFY_ZERO still check every page 
+ *  and zero any that is not. Memory must be 
+ *  unlocked.
  ***********************************************/
-static inline void
-uvl_offset_import (module_imports_t *import,   ///< Import table to modify
-                                int addend)    ///< Positive or negative number to add to all offsets
+void
+uvl_elf_zero_bss (void *start,      ///< Start of memory past the file data
+                 u32_t length,      ///< Bytes to zero
+                   int zeroed)      ///< Set if nothing wrote past @a start since a block known to be zero filled was allocated
 {
-    int i;
-    IF_VERBOSE LOG ("Modifying import table offsets for 0x%08X", (u32_t)import);
-    import->lib_name = (void*)((u32_t)import->lib_name + addend);
-    import->func_nid_table = (void*)((u32_t)import->func_nid_table + addend);
-    import->func_entry_table = (void*)((u32_t)import->func_entry_table + addend);
-    import->var_nid_table = (void*)((u32_t)import->var_nid_table + addend);
-    import->var_entry_table = (void*)((u32_t)import->var_entry_table + addend);
-    import->tls_nid_table = (void*)((u32_t)import->tls_nid_table + addend);
-    import->tls_entry_table = (void*)((u32_t)import->tls_entry_table + addend);
-    IF_VERBOSE LOG ("Modifying import table entries offsets for 0x%08X", (u32_t)import);
-    for (i = 0; i < import->num_functions; i++)
+    if (!zeroed)
     {
-        import->func_entry_table[i] = (void*)((u32_t)import->func_entry_table[i] + addend);
+        IF_DEBUG LOG ("Zeroing %u remainder of memory.", length);
+        memset (start, 0, length);
+        return;
     }
-    for (i = 0; i < import->num_vars; i++)
-    {
-        import->var_entry_table[i] = (void*)((u32_t)import->var_entry_table[i] + addend);
-    }
-    for (i = 0; i < import->num_tls_vars; i++)
+    IF_DEBUG LOG ("Skipped zeroing %u bytes of fresh memory.", length);
+#ifdef UVL_VERIFY_ZERO
+    u32_t *page;
+    u32_t *end;
+    u32_t *p;
+
+    // the tail may share a page with file data, only check whole words past it
+    page = (u32_t*)(((u32_t)start + sizeof (u32_t) - 1) & ~(sizeof (u32_t) - 1));
+    end = (u32_t*)(((u32_t)start + length) & ~(sizeof (u32_t) - 1));
+    memset (start, 0, (u32_t)page - (u32_t)start);
+    for (; page < end; page = p)
     {
-        import->tls_entry_table[i] = (void*)((u32_t)import->tls_entry_table[i] + addend);
+        p = (u32_t*)(((u32_t)page + UVL_PAGE_SIZE) & ~(UVL_PAGE_SIZE - 1));
+        if (p > end)
+        {
+            p = end;
+        }
+        while (page < p && *page == 0)
+        {
+            page++;
+        }
+        if (page < p)
+        {
+            LOG ("Fresh memory at 0x%08X is not zero, zeroing page.", (u32_t)page);
+            memset (page, 0, (u32_t)p - (u32_t)page);
+        }
     }
+    memset (end, 0, (u32_t)start + length - (u32_t)end);
+#endif
 }
 
 /********************************************//**
- *  \brief Loads an ELF file
+ *  \brief Resolves a list of import tables
  *  
- *  Performs both loading and resolving NIDs
+ *  If @a file is given, the tables are in the 
+ *  file instead of loaded and their pointers 
+ *  are translated for resolving then put back.
  *  \returns Zero on success, otherwise error
  ***********************************************/
-int 
-uvl_load_elf (void *data,           ///< ELF data start
-              void **entry)         ///< Returned pointer to entry pointer
+int
+uvl_elf_resolve_imports (module_imports_t *import,  ///< First import table
+                                     void *end,     ///< End of import tables
+                               elf_file_t *file)    ///< ELF the tables are in, NULL if loaded
 {
-    Elf32_Ehdr_t *elf_hdr;
-    u32_t i;
-    int addend;
-    *entry = NULL;
-
-    // get headers
-    IF_VERBOSE LOG ("Reading headers.");
-    elf_hdr = data;
-    IF_DEBUG LOG ("Checking headers.");
-    if (uvl_elf_check_header (elf_hdr) < 0)
-    {
-        LOG ("Check header failed.");
-        return -1;
-    }
-
-    // get program headers
-    Elf32_Phdr_t *prog_hdrs;
-    IF_VERBOSE LOG ("Reading program headers.");
-    prog_hdrs = (void*)((u32_t)data + elf_hdr->e_phoff);
-
-    // get mod_info
-    module_info_t *mod_info;
-    IF_DEBUG LOG ("Getting module info.");
-    if (uvl_elf_get_module_info (data, elf_hdr, &mod_info) < 0)
-    {
-        LOG ("Cannot find module info section.");
-        return -1;
-    }
-    IF_DEBUG LOG ("Module name: %s, export table offset: 0x%08X, import table offset: 0x%08X", mod_info->modname, mod_info->ent_top, mod_info->stub_top);
-
-    // free memory
-    IF_DEBUG LOG ("Cleaning up memory.");
-    if (uvl_elf_free_memory (prog_hdrs, elf_hdr->e_phnum) < 0)
-    {
-        LOG ("Error freeing memory.");
-        return -1;
-    }
+    module_ports_iter_t iter;
+    int ret;
 
-    // actually load the ELF
-    PsvUID memblock;
-    void *blockaddr;
-    u32_t length;
-    if (elf_hdr->e_phnum < 1)
-    {
-        LOG ("No program sections to load!");
-        return -1;
-    }
-    IF_DEBUG LOG ("Loading %u program sections.", elf_hdr->e_phnum);
-    for (i = 0; i < elf_hdr->e_phnum; i++)
+    uvl_module_ports_begin (&iter, import, end, MODULE_PORTS_IMPORTS, 0);
+    while ((import = (module_imports_t*)uvl_module_ports_next (&iter)) != NULL)
     {
-        if (prog_hdrs[i].p_type != PT_LOAD || prog_hdrs[i].p_vaddr == 0)
+        if (file != NULL)
         {
-            IF_DEBUG LOG ("Section %u is not loadable. Skipping.", i);
-            continue;
+            uvl_offset_import (import, file, 1);
         }
-        length = prog_hdrs[i].p_memsz;
-        length = (length + 0xFFFFF) & ~0xFFFFF; // Align to 1MB
-        if (prog_hdrs[i].p_flags & PF_X == PF_X) // executable section
+        ret = 0;
+        IF_DEBUG LOG ("Loading module for %s", import->lib_name);
+        if (uvl_load_module_for_lib (import->lib_name) < 0)
         {
-            memblock = sceKernelAllocCodeMemBlock ("UVLHomebrew", length);
+            LOG ("Cannot load required module for %s. May still be possible to resolve with cached entries. Continuing.", import->lib_name);
         }
-        else // data section
+        else
         {
-            memblock = sceKernelAllocMemBlock ("UVLHomebrew", 0xC20D060, length, NULL);
+            IF_DEBUG LOG ("Resolving imports for %s", import->lib_name);
+            if ((ret = uvl_resolve_imports (import)) < 0)
+            {
+                LOG ("Failed to resolve imports for %s", import->lib_name);
+            }
         }
-        if (memblock < 0)
+        if (file != NULL)
         {
-            LOG ("Error allocating memory. 0x%08X", memblock);
-            return -1;
+            uvl_offset_import (import, file, 0);
         }
-        if (sceKernelGetMemBlockBase (memblock, &blockaddr) < 0)
+        if (ret < 0)
         {
-            LOG ("Error getting memory block address.");
+            // names are only readable until this returns
+            uvl_resolve_trap_report ();
+            return -1;
         }
-        if ((u32_t)blockaddr != (u32_t)prog_hdrs[i].p_vaddr)
+    }
+    uvl_resolve_trap_report ();
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Adds the libraries a loaded 
+ *  executable exports to the resolve table
+ *  
+ *  With a hashed export index, the entries are 
+ *  added straight from it, otherwise every 
+ *  export table is walked. The module info 
+ *  table is not a library and is skipped.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_elf_add_exports (void *base,            ///< Where the first segment is loaded
+            module_info_t *mod_info,        ///< Module information
+           export_index_t *index)           ///< Hashed export index, can be NULL
+{
+    module_ports_iter_t iter;
+    module_exports_t *export;
+    export_index_entry_t *entries;
+    resolve_entry_t entry;
+    u32_t i;
+
+    if (index == NULL)
+    {
+        uvl_module_ports_begin (&iter, (void*)((u32_t)base + mod_info->ent_top), (void*)((u32_t)base + mod_info->ent_end), MODULE_PORTS_EXPORTS, 0);
+        while ((export = (module_exports_t*)uvl_module_ports_next (&iter)) != NULL)
         {
-            LOG ("Error, section %u wants to be loaded to 0x%08X but we allocated 0x%08X", i, (u32_t)prog_hdrs[i].p_vaddr, (u32_t)blockaddr);
-            //return -1;
+            if (export->attribute != ATTR_MOD_INFO && uvl_resolve_add_exports (export) < 0)
+            {
+                return -1;
+            }
         }
-
-        IF_DEBUG LOG ("Allocated memory at 0x%08X, attempting to load section %u.", (u32_t)blockaddr, i);
-        psvUnlockMem ();
-        memcpy (blockaddr, (void*)((u32_t)data + prog_hdrs[i].p_offset), prog_hdrs[i].p_filesz);
-        IF_DEBUG LOG ("Zeroing %u remainder of memory.", prog_hdrs[i].p_memsz - prog_hdrs[i].p_filesz);
-        memset ((void*)((u32_t)blockaddr + prog_hdrs[i].p_filesz), 0, prog_hdrs[i].p_memsz - prog_hdrs[i].p_filesz);
-        psvLockMem ();
+        return 0;
     }
-
-    // resolve NIDs
-    module_imports_t *import;
-    void  *end;
-    import = (void*)(prog_hdrs[0].p_vaddr + mod_info->stub_top);
-    end = (void*)(prog_hdrs[0].p_vaddr + mod_info->stub_end);
-    for (i = 0; (void*)&import[i] < end; i++)
+    entries = (export_index_entry_t*)&((u32_t*)&index[1])[index->bloom_words + index->num_buckets];
+    for (i = 0; i < index->num_entries; i++)
     {
-        IF_DEBUG LOG ("Loading module for %s", import[i].lib_name);
-        if (uvl_load_module_for_lib (import[i].lib_name) < 0)
+        export = (module_exports_t*)((u32_t)base + mod_info->ent_top + entries[i].table);
+        if (export->attribute == ATTR_MOD_INFO)
         {
-            LOG ("Cannot load required module for %s. May still be possible to resolve with cached entries. Continuing.", import[i].lib_name);
             continue;
         }
-        IF_DEBUG LOG ("Resolving imports for %s", import[i].lib_name);
-        if (uvl_resolve_imports (&import[i]) < 0)
+        entry.nid = entries[i].nid;
+        if (entries[i].index < export->num_functions)
         {
-            LOG ("Failed to resolve imports for %s", import[i].lib_name);
+            entry.type = RESOLVE_TYPE_FUNCTION;
+            entry.value.func_ptr = export->entry_table[entries[i].index];
+        }
+        else
+        {
+            entry.type = RESOLVE_TYPE_VARIABLE_REF; // read when imported
+            entry.value.ptr = export->entry_table[entries[i].index];
+        }
+        if (uvl_resolve_table_add (&entry) < 0)
+        {
+            LOG ("Error adding entry to table.");
             return -1;
         }
     }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Resolves a loaded executable and 
+ *  finds its entry point
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_elf_link (void *base,                   ///< Where the first segment is loaded
+     module_info_t *mod_info,               ///< Module information
+    export_index_t *index,                  ///< Hashed export index, can be NULL
+              void **entry)                 ///< Returned pointer to entry pointer
+{
+    if (uvl_elf_add_exports (base, mod_info, index) < 0)
+    {
+        LOG ("Cannot add exported libraries.");
+        return -1;
+    }
+    if (uvl_elf_resolve_imports ((void*)((u32_t)base + mod_info->stub_top), (void*)((u32_t)base + mod_info->stub_end), NULL) < 0)
+    {
+        return -1;
+    }
+    return uvl_elf_find_entry (base, mod_info, index, entry);
+}
+
+/********************************************//**
+ *  \brief Finds the entry point of a loaded 
+ *  executable
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_elf_find_entry (void *base,             ///< Where the first segment is loaded
+           module_info_t *mod_info,         ///< Module information
+          export_index_t *index,            ///< Hashed export index, can be NULL
+                    void **entry)           ///< Returned pointer to entry pointer
+{
+    module_ports_iter_t iter;
 
     // find the entry point
     module_exports_t *export;
-    u32_t j;
-    export = (void*)(prog_hdrs[0].p_vaddr + mod_info->ent_top);
-    end = (void*)(prog_hdrs[0].p_vaddr + mod_info->ent_end);
-    for (i = 0; (void*)&export[i] < end; i++)
+    u32_t entry_nid = ENTRY_NID;
+    int j;
+    export = (void*)((u32_t)base + mod_info->ent_top);
+    if (index != NULL)
+    {
+        *entry = uvl_export_index_find (index, export, ENTRY_NID, ATTR_MOD_INFO);
+        if (*entry == NULL)
+        {
+            LOG ("Cannot find application entry.");
+            return -1;
+        }
+        IF_DEBUG LOG ("Found application entry at 0x%08X", (u32_t)*entry);
+        return 0;
+    }
+    uvl_module_ports_begin (&iter, export, (void*)((u32_t)base + mod_info->ent_end), MODULE_PORTS_EXPORTS, 0);
+    while ((export = (module_exports_t*)uvl_module_ports_next (&iter)) != NULL)
     {
-        if (export[i].attribute != ATTR_MOD_INFO)
+        if (export->attribute != ATTR_MOD_INFO)
         {
             continue;
         }
-        for (j = 0; j < export[i].num_functions; j++)
+        if ((j = nid_find (export->nid_table, export->num_functions, &entry_nid, 1)) != -1)
         {
-            if (export[i].nid_table[j] == ENTRY_NID)
-            {
-                *entry = export[i].entry_table[j];
-                IF_DEBUG LOG ("Found application entry at 0x%08X", *entry);
-                return 0;
-            }
+            *entry = export->entry_table[j];
+            IF_DEBUG LOG ("Found application entry at 0x%08X", (u32_t)*entry);
+            return 0;
         }
     }
     LOG ("Cannot find application entry.");
@@ -411,69 +1416,228 @@ uvl_elf_check_header (Elf32_Ehdr_t *hdr) ///< ELF header to check
         LOG ("Unsupported ELF version.");
         return -1;
     }
-    // contains headers
-    if (!(hdr->e_shoff > 0 && hdr->e_phoff > 0))
+    // contains program headers, section headers are optional
+    if (!(hdr->e_phoff > 0))
     {
-        LOG ("Missing table header(s).");
+        LOG ("Missing program header table.");
         return -1;
     }
-    // contains strings
-    if (!(hdr->e_shstrndx > 0))
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Gets the offset of SCE module info 
+ *  from the program headers
+ *  
+ *  Vita toolchains store the offset of the 
+ *  module information in the first segment 
+ *  in that segment's physical address. This 
+ *  works on files without section headers.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_elf_get_module_info_offset (Elf32_Phdr_t *prog_hdr,    ///< Program header of the first segment
+                                       u32_t *offset)      ///< Returned offset from start of segment
+{
+    *offset = (u32_t)prog_hdr->p_paddr & 0x3FFFFFFF;
+    if (*offset == 0 || *offset + sizeof (module_info_t) > prog_hdr->p_filesz)
     {
-        LOG ("Missing strings table.");
+        IF_DEBUG LOG ("No module info offset in first segment.");
         return -1;
     }
+    IF_DEBUG LOG ("Module info at offset 0x%X of first segment.", *offset);
     return 0;
 }
 
 /********************************************//**
  *  \brief Finds SCE module info
  *  
- *  This function locates the strings table 
- *  and finds the section where the module 
- *  information resides. Then it reads the 
- *  module information. This function will 
- *  move the pointer in the file descriptor.
+ *  The offset in the first program header is 
+ *  tried first. Otherwise this function 
+ *  locates the strings table and finds the 
+ *  section where the module information 
+ *  resides.
  *  \returns Zero on success, otherwise error
  ***********************************************/
 int 
 uvl_elf_get_module_info (void *data,            ///< ELF data start
+                        u32_t size,             ///< Bytes of ELF data
                  Elf32_Ehdr_t *elf_hdr,         ///< ELF header
                 module_info_t **mod_info)       ///< Where to read information to
 {
     Elf32_Shdr_t *sec_hdr;
+    Elf32_Phdr_t *prog_hdr;
+    u32_t offset;
+    // try the program header first
+    prog_hdr = (void*)((u32_t)data + elf_hdr->e_phoff);
+    if (elf_hdr->e_phnum > 0 && uvl_elf_get_module_info_offset (prog_hdr, &offset) == 0)
+    {
+        *mod_info = (void*)((u32_t)data + prog_hdr->p_offset + offset);
+        return 0;
+    }
+    if (uvl_elf_find_section (data, size, elf_hdr, UVL_SEC_MODINFO, &sec_hdr) < 0)
+    {
+        LOG ("Cannot find module info.");
+        return -1;
+    }
+    *mod_info = (void*)((u32_t)data + sec_hdr->sh_offset);
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Finds a section by name
+ *  
+ *  This function locates the strings table 
+ *  and finds the section with the name. The 
+ *  section headers, the strings table and the 
+ *  section found must all be inside @a size.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_elf_find_section (void *data,               ///< ELF data start
+                     u32_t size,                ///< Bytes of ELF data
+              Elf32_Ehdr_t *elf_hdr,            ///< ELF header
+                      char *name,               ///< Name of section
+              Elf32_Shdr_t **sec_hdr)           ///< Returned section header
+{
+    if (!(elf_hdr->e_shoff > 0 && elf_hdr->e_shstrndx > 0))
+    {
+        IF_DEBUG LOG ("No section headers to find %s.", name);
+        return -1;
+    }
+    if (elf_hdr->e_shentsize != sizeof (Elf32_Shdr_t) || elf_hdr->e_shstrndx >= elf_hdr->e_shnum || 
+        elf_hdr->e_shoff > size || elf_hdr->e_shnum * sizeof (Elf32_Shdr_t) > size - elf_hdr->e_shoff)
+    {
+        LOG ("Section headers are outside the file.");
+        return -1;
+    }
     // find strings table
     IF_DEBUG LOG ("Reading strings table header.");
-    sec_hdr = (void*)((u32_t)data + elf_hdr->e_shoff + elf_hdr->e_shstrndx * elf_hdr->e_shentsize);
+    *sec_hdr = (void*)((u32_t)data + elf_hdr->e_shoff + elf_hdr->e_shstrndx * elf_hdr->e_shentsize);
 
-    IF_DEBUG LOG ("String table at %08X for %08X", sec_hdr->sh_offset, sec_hdr->sh_size);
+    IF_DEBUG LOG ("String table at %08X for %08X", (*sec_hdr)->sh_offset, (*sec_hdr)->sh_size);
+    if ((*sec_hdr)->sh_offset > size || (*sec_hdr)->sh_size > size - (*sec_hdr)->sh_offset)
+    {
+        LOG ("String table is outside the file.");
+        return -1;
+    }
     char *strings;
     int name_idx;
-    strings = (void*)((u32_t)data + sec_hdr->sh_offset);
-    name_idx = memstr (strings, sec_hdr->sh_size, UVL_SEC_MODINFO, strlen (UVL_SEC_MODINFO)) - strings;
+    strings = (void*)((u32_t)data + (*sec_hdr)->sh_offset);
+    name_idx = memstr (strings, (*sec_hdr)->sh_size, name, strlen (name)) - strings;
     if (name_idx <= 0)
     {
-        LOG ("Cannot find section %s in string table.", UVL_SEC_MODINFO);
+        IF_DEBUG LOG ("Cannot find section %s in string table.", name);
         return -1;
     }
-    IF_DEBUG LOG ("Index of %s: %u", UVL_SEC_MODINFO, name_idx);
-    // find sceModuleInfo section
+    IF_DEBUG LOG ("Index of %s: %u", name, name_idx);
+    // find the section
     int i;
     IF_DEBUG LOG ("Reading %u sections.", elf_hdr->e_shnum);
     for (i = 0; i < elf_hdr->e_shnum; i++)
     {
-        sec_hdr = (void*)((u32_t)data + elf_hdr->e_shoff + i * sizeof (Elf32_Shdr_t));
-        if (sec_hdr->sh_name == name_idx) // we want this section
+        *sec_hdr = (void*)((u32_t)data + elf_hdr->e_shoff + i * sizeof (Elf32_Shdr_t));
+        if ((*sec_hdr)->sh_name == name_idx) // we want this section
         {
+            if ((*sec_hdr)->sh_offset > size || (*sec_hdr)->sh_size > size - (*sec_hdr)->sh_offset)
+            {
+                LOG ("Section %s is outside the file.", name);
+                return -1;
+            }
             IF_DEBUG LOG ("Found requested section %u.", i);
-            IF_DEBUG LOG ("Reading section at offset 0x%08X. Size: %u", sec_hdr->sh_offset, sec_hdr->sh_size);
-            *mod_info = (void*)((u32_t)data + sec_hdr->sh_offset);
+            IF_DEBUG LOG ("Reading section at offset 0x%08X. Size: %u", (*sec_hdr)->sh_offset, (*sec_hdr)->sh_size);
             return 0;
         }
     }
     return -1;
 }
 
+/********************************************//**
+ *  \brief Finds the hashed export index
+ *  
+ *  The index is added to the file by 
+ *  @c uvl-expidx after linking. It is optional, 
+ *  executables without one are searched 
+ *  linearly.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_elf_get_export_index (void *data,           ///< ELF data start
+                         u32_t size,            ///< Bytes of ELF data
+                  Elf32_Ehdr_t *elf_hdr,        ///< ELF header
+                export_index_t **index)         ///< Returned index
+{
+    Elf32_Shdr_t *sec_hdr;
+    export_index_t *idx;
+    u32_t length;
+
+    *index = NULL;
+    if (uvl_elf_find_section (data, size, elf_hdr, UVL_SEC_EXPIDX, &sec_hdr) < 0)
+    {
+        return -1;
+    }
+    idx = (void*)((u32_t)data + sec_hdr->sh_offset);
+    if (sec_hdr->sh_size < sizeof (export_index_t) || idx->magic != EXPIDX_MAGIC)
+    {
+        LOG ("Invalid export index.");
+        return -1;
+    }
+    length = sizeof (export_index_t) + (idx->bloom_words + idx->num_buckets) * sizeof (u32_t) + idx->num_entries * sizeof (export_index_entry_t);
+    if (length > sec_hdr->sh_size || 
+        (idx->num_buckets & (idx->num_buckets - 1)) || idx->num_buckets == 0 || 
+        (idx->bloom_words & (idx->bloom_words - 1)) || idx->bloom_words == 0)
+    {
+        LOG ("Invalid export index.");
+        return -1;
+    }
+    IF_DEBUG LOG ("Found export index of %u entries.", idx->num_entries);
+    *index = idx;
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Looks up an export with the hashed 
+ *  export index
+ *  
+ *  \returns Exported entry on success, NULL 
+ *  if not found
+ ***********************************************/
+void *
+uvl_export_index_find (export_index_t *index,   ///< Index of the executable
+                                 void *ent_top, ///< Loaded start of export tables
+                                u32_t nid,      ///< NID to find
+                                u16_t attribute) ///< Only match tables with this attribute, or @c EXPIDX_ANY_ATTR
+{
+    u32_t *bloom;
+    u32_t *buckets;
+    export_index_entry_t *entries;
+    module_exports_t *exports;
+    u32_t bucket;
+    u32_t i;
+
+    bloom = (u32_t*)&index[1];
+    buckets = &bloom[index->bloom_words];
+    entries = (export_index_entry_t*)&buckets[index->num_buckets];
+    if (!(EXPIDX_BLOOM_TEST (bloom, index->bloom_words, nid)))
+    {
+        return NULL;
+    }
+    bucket = nid & (index->num_buckets - 1);
+    for (i = buckets[bucket]; i < index->num_entries && (entries[i].nid & (index->num_buckets - 1)) == bucket; i++)
+    {
+        if (entries[i].nid != nid)
+        {
+            continue;
+        }
+        exports = (module_exports_t*)((u32_t)ent_top + entries[i].table);
+        if (attribute == EXPIDX_ANY_ATTR || exports->attribute == attribute)
+        {
+            return exports->entry_table[entries[i].index];
+        }
+    }
+    return NULL;
+}
+
 /********************************************//**
  *  \brief Frees memory of where we want to load
  *  
@@ -492,7 +1656,6 @@ uvl_elf_free_memory (Elf32_Phdr_t *prog_hdrs,   ///< Array of program headers
     PsvUID mod_list[MAX_LOADED_MODS];
     u32_t num_loaded = MAX_LOADED_MODS;
     int i, j;
-    u32_t length;
     int temp[2];
 
     IF_VERBOSE LOG ("Reading %u program headers.", count);
@@ -531,6 +1694,7 @@ uvl_elf_free_memory (Elf32_Phdr_t *prog_hdrs,   ///< Array of program headers
             if (m_mod_info.segments[j].vaddr == (void*)0x81000000)
             {
                 IF_DEBUG LOG ("Module %s segment %u (0x%08X, size %u) is in our address space. Attempting to unload.", m_mod_info.module_name, j, (u32_t)m_mod_info.segments[j].vaddr, m_mod_info.segments[j].memsz);
+                uvl_resolve_table_pin (&m_mod_info);
                 if (sceKernelStopUnloadModule (mod_list[i], 0, 0, 0, &temp[0], &temp[1]) < 0)
                 {
                     LOG ("Error unloading %s.", m_mod_info.module_name);
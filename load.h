@@ -81,12 +81,35 @@ typedef u16_t   Elf32_Half;
 #define SCEMAG1     'C'
 #define SCEMAG2     'E'
 #define SCEMAG3     0
-#define SCEHDR_LEN  0x1000
+/** @}*/
+/** \name SCE header values
+ *  @{
+ */
+#define SCE_TYPE_SELF           1       ///< @c header_type of a SELF
+#define SCE_SEGMENT_COMPRESSED  2       ///< @c compression of a compressed segment
+#define SCE_SEGMENT_ENCRYPTED   1       ///< @c encryption of an encrypted segment
 /** @}*/
 #define UVL_SEC_MODINFO        ".sceModuleInfo.rodata" ///< Name of module information section
+#define UVL_SEC_EXPIDX         ".uvl.expidx"           ///< Name of hashed export index section
 #define UVL_SEC_MIN_ALIGN      0x100000                ///< Alignment of each section
+#define UVL_PAGE_SIZE          0x1000                  ///< Size of a memory page
 #define UVL_BIN_MAX_SIZE       0x200000                ///< 2MB max, change in the future
+#define UVL_READ_CHUNK         0x10000                 ///< Bytes read at a time when checksumming a streamed segment
+#define UVL_CHECKSUM_EXT       ".crc"                  ///< Added to executable path to find its checksum
+#define MAX_PATH_LENGTH        0x100                   ///< Maximum length of a file path
 #define ATTR_MOD_INFO          0x8000                  ///< module_exports_t attribute
+
+/** \name Memory block types
+ *  Kinds of blocks segments are loaded to, 
+ *  each probed separately for zero fill.
+ *  @{
+ */
+#define UVL_MEM_DATA            0       ///< Block from sceKernelAllocMemBlock
+#define UVL_MEM_CODE            1       ///< Block from sceKernelAllocCodeMemBlock
+#define UVL_MEM_TYPES           2       ///< Number of block types
+/** Block type a segment is loaded to */
+#define UVL_SEGMENT_MEM(prog_hdr) (((prog_hdr)->p_flags & PF_X) ? UVL_MEM_CODE : UVL_MEM_DATA)
+/** @}*/
 #define ENTRY_NID              0x935CD196              ///< NID of entry function
 
 /** \name ELF structures
@@ -138,26 +161,152 @@ typedef struct Elf32_Phdr
 } Elf32_Phdr_t;
 /** @}*/
 
+/**
+ * \brief An ELF read to memory
+ * 
+ * Used to reach loaded addresses in the file 
+ * before it is loaded.
+ */
+typedef struct elf_file
+{
+    void            *data;      ///< ELF data start
+    Elf32_Phdr_t    *prog_hdrs; ///< Program headers
+    u32_t           count;      ///< Number of program headers
+} elf_file_t;
+
+/** \name SCE structures
+ *  @{
+ */
+typedef struct sce_header
+{
+    u32_t   magic;                  ///< "SCE\0"
+    u32_t   version;                ///< Header version, 3
+    u16_t   sdk_type;
+    u16_t   header_type;            ///< See defined "SCE header values"
+    u32_t   metadata_offset;
+    u64_t   header_len;             ///< Length of everything before the first segment
+    u64_t   elf_filesize;
+    u64_t   self_filesize;
+    u64_t   unknown;
+    u64_t   self_offset;
+    u64_t   appinfo_offset;
+    u64_t   elf_offset;             ///< Offset of ELF header
+    u64_t   phdr_offset;            ///< Offset of program headers
+    u64_t   shdr_offset;            ///< Offset of section headers
+    u64_t   section_info_offset;    ///< Offset of segment info table, one per program header
+    u64_t   sceversion_offset;
+    u64_t   controlinfo_offset;
+    u64_t   controlinfo_size;
+    u64_t   padding;
+} sce_header_t;
+
+typedef struct sce_segment_info
+{
+    u64_t   offset;                 ///< Offset of segment in file
+    u64_t   length;                 ///< Length of segment in file
+    u64_t   compression;            ///< 1 = uncompressed, 2 = compressed
+    u64_t   encryption;             ///< 1 = encrypted, 2 = plain
+} sce_segment_info_t;
+/** @}*/
+
+/** \name Hashed export index
+ *  Optional section added by @c tools/uvl-expidx. The 
+ *  layout is the header, @c bloom_words bloom filter 
+ *  words, @c num_buckets bucket starts, then entries 
+ *  grouped by bucket. All fields are little endian.
+ *  @{
+ */
+#define EXPIDX_MAGIC        0x49585655  ///< "UVXI"
+#define EXPIDX_ANY_ATTR     0xFFFF      ///< Match exports of any attribute
+/** Checks the bloom filter, two bits in one word per NID */
+#define EXPIDX_BLOOM_TEST(bloom, words, nid) \
+    (((bloom)[((nid) >> 5) & ((words) - 1)] >> ((nid) & 31)) & ((bloom)[((nid) >> 5) & ((words) - 1)] >> (((nid) >> 26) & 31)) & 1)
+
+typedef struct export_index
+{
+    u32_t   magic;              ///< @c EXPIDX_MAGIC
+    u32_t   num_buckets;        ///< Number of buckets, power of two, bucket is NID masked
+    u32_t   bloom_words;        ///< Number of bloom filter words, power of two
+    u32_t   num_entries;        ///< Number of entries
+} export_index_t;
+
+typedef struct export_index_entry
+{
+    u32_t   nid;                ///< Exported NID
+    u16_t   table;              ///< Offset of the export table from @c ent_top
+    u16_t   index;              ///< Index in the table's NID and entry arrays
+} export_index_entry_t;
+/** @}*/
+
+/** \name Parallel segment loading
+ *  @{
+ */
+#define UVL_LOAD_CHUNK_SHIFT    18                      ///< Log2 of bytes copied or zeroed by one worker at a time
+#define UVL_LOAD_CHUNK          (1 << UVL_LOAD_CHUNK_SHIFT) ///< Bytes copied or zeroed by one worker at a time
+#define UVL_LOAD_MAX_THREADS    3                       ///< Workers, one per user core
+#define UVL_LOAD_MAX_SEGMENTS   8                       ///< Segments loaded in one batch
+#define UVL_LOAD_PARALLEL_MIN   0x100000                ///< Smaller images are loaded on one thread
+
+typedef struct load_segment
+{
+    u8_t    *dst;               ///< Loaded address
+    u8_t    *src;               ///< File data
+    u32_t   copy;               ///< Bytes to copy
+    u32_t   zero;               ///< Bytes to zero after the copy
+    u32_t   first;              ///< Index of the segment's first chunk
+} load_segment_t;
+
+typedef struct load_work
+{
+    load_segment_t  segments[UVL_LOAD_MAX_SEGMENTS];
+    u32_t           num_segments;   ///< Segments added
+    u32_t           num_chunks;     ///< Chunks in all segments
+    u32_t           bytes;          ///< Bytes in all segments
+    volatile u32_t  next;           ///< Next chunk to take
+} load_work_t;
+/** @}*/
+
 /** \cond predefined-types
  *  @{
  */
 typedef struct module_info module_info_t;
+typedef struct module_imports module_imports_t;
 /** @}*/
 
 /** \name Functions to load code
  *  @{
  */
 int uvl_load_file (const char *filename, void **data, PsvSSize *size);
+int uvl_free_data (void *data);
 int uvl_load_exe (const char *filename, void **entry);
-int uvl_load_elf (void *data, void **entry);
+int uvl_load_elf (void *data, u32_t size, u32_t *checksum, void **entry);
+int uvl_load_self (PsvUID fd, u32_t *checksum, void **entry);
 int uvl_load_module_for_lib (char *lib_name);
 /** @}*/
 /** \name Helper functions
  *  @{
  */
 int uvl_elf_check_header (Elf32_Ehdr_t *hdr);
-int uvl_elf_get_module_info (void *data, Elf32_Ehdr_t *elf_hdr, module_info_t **mod_info);
+int uvl_elf_get_module_info (void *data, u32_t size, Elf32_Ehdr_t *elf_hdr, module_info_t **mod_info);
+int uvl_elf_get_module_info_offset (Elf32_Phdr_t *prog_hdr, u32_t *offset);
 int uvl_elf_free_memory (Elf32_Phdr_t *prog_hdrs, int count);
+int uvl_elf_alloc_segment (Elf32_Phdr_t *prog_hdr, u32_t index, void **blockaddr);
+int uvl_elf_link (void *base, module_info_t *mod_info, export_index_t *index, void **entry);
+int uvl_elf_add_exports (void *base, module_info_t *mod_info, export_index_t *index);
+int uvl_elf_resolve_imports (module_imports_t *import, void *end, elf_file_t *file);
+void *uvl_elf_vaddr_to_file (elf_file_t *file, u32_t addr, u32_t length);
+int uvl_elf_find_entry (void *base, module_info_t *mod_info, export_index_t *index, void **entry);
+int uvl_elf_find_section (void *data, u32_t size, Elf32_Ehdr_t *elf_hdr, char *name, Elf32_Shdr_t **sec_hdr);
+int uvl_elf_get_export_index (void *data, u32_t size, Elf32_Ehdr_t *elf_hdr, export_index_t **index);
+void *uvl_export_index_find (export_index_t *index, void *ent_top, u32_t nid, u16_t attribute);
+void uvl_elf_zero_bss (void *start, u32_t length, int zeroed);
+int uvl_mem_fresh_is_zero (int type);
+/** @}*/
+/** \name Parallel segment loading
+ *  @{
+ */
+int uvl_load_work_add (load_work_t *work, void *dst, void *src, u32_t copy, u32_t zero);
+void uvl_load_work_run (load_work_t *work, u32_t threads);
 /** @}*/
 
 #endif
@@ -16,6 +16,7 @@
  */
 #include "resolve.h"
 #include "scefuncs.h"
+#include "snapshot.h"
 #include "utils.h"
 
 /** Checks if a bit is set in a given member */
@@ -24,23 +25,74 @@
 /** Stores resolve entries */
 struct resolve_table {
     PsvUID             block_uid;   ///< UID of the memory block for freeing
-    u32_t              length;      ///< Number of entries
+    u32_t              length;      ///< Number of entries, published after the entry is written
+    u32_t              sorted;      ///< Number of leading entries sorted by NID, fixed once published
     resolve_entry_t    table[];     ///< Table entries
 } *g_resolve_table = NULL;
 
+/**
+ * Tracks readers of published resolve tables
+ * 
+ * Readers register in the parity of the current 
+ * epoch. To retire a table, the writer moves to 
+ * the next epoch and waits for the readers of 
+ * the previous one to leave. The block is never 
+ * freed so readers can always reach it.
+ */
+struct resolve_epoch {
+    PsvUID             block_uid;   ///< UID of the memory block
+    volatile u32_t     epoch;       ///< Current epoch
+    volatile u32_t     readers[2];  ///< Readers inside an even or odd epoch
+} *g_resolve_epoch = NULL;
+
+/** One NID of an import table waiting to be resolved */
+typedef struct import_slot {
+    u32_t              nid;         ///< NID to resolve
+    void               *stub;       ///< Stub or variable reference to patch
+    resolve_entry_t    *resolve;    ///< Matching entry, NULL if unresolved
+    u32_t              type;        ///< @c RESOLVE_TYPE_FUNCTION or @c RESOLVE_TYPE_VARIABLE
+} import_slot_t;
+
+/** Scratch space for batch resolving, stored after the resolve table */
+#define IMPORT_SLOTS ((import_slot_t*)&g_resolve_table->table[MAX_RESOLVE_ENTRIES])
+
+/**
+ * Unresolved imports and calls made to them
+ * 
+ * Misses are kept until they are reported 
+ * after resolving. Calls are recorded by the 
+ * trap while the homebrew runs, so the block 
+ * is never freed.
+ */
+struct resolve_trap {
+    PsvUID             block_uid;   ///< UID of the memory block
+    u32_t              num_misses;  ///< Unresolved imports since the last report
+    volatile u32_t     num_calls;   ///< Calls to the trap, may be more than recorded
+    struct resolve_miss
+    {
+        u32_t          nid;         ///< Unresolved NID
+        char           *lib_name;   ///< Library imported from, valid until reported
+    } misses[MAX_RESOLVE_MISSES];
+    struct
+    {
+        u32_t          nid;         ///< NID called
+        void           *caller;     ///< Return address of the call
+    } calls[MAX_TRAP_CALLS];
+} *g_resolve_trap = NULL;
+
 /********************************************//**
- *  \brief Allocates memory for resolve table.
+ *  \brief Allocates memory for a resolve table
  *  
  *  \returns Zero on success, otherwise error
  ***********************************************/
-int 
-uvl_resolve_table_initialize ()
+static int
+uvl_resolve_table_alloc (struct resolve_table **table)  ///< Returned empty table
 {
     u32_t size;
     PsvUID block;
     void *base;
 
-    size = (MAX_RESOLVE_ENTRIES * sizeof (resolve_entry_t) + sizeof (u32_t) + sizeof (PsvUID) + 0xFFF) & ~0xFFF; // store block id, counter, table, and align to 0x1000 bytes
+    size = (sizeof (struct resolve_table) + MAX_RESOLVE_ENTRIES * sizeof (resolve_entry_t) + MAX_IMPORT_SLOTS * sizeof (import_slot_t) + 0xFFF) & ~0xFFF; // store header, table, import scratch, and align to 0x1000 bytes
     IF_DEBUG LOG ("Creating resolve table of size %u.", size);
     block = sceKernelAllocMemBlock ("UVLTable", 0xC20D060, size, NULL);
     if (block < 0)
@@ -54,44 +106,111 @@ uvl_resolve_table_initialize ()
         return -1;
     }
     IF_DEBUG LOG ("Block UID 0x%08X allocated at 0x%08X", (u32_t)block, (u32_t)base);
+    *table = base;
+    (*table)->block_uid = block;
+    (*table)->length = 0;
+    (*table)->sorted = 0;
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Publishes a new resolve table and 
+ *  frees the old one once no reader uses it
+ *  
+ *  Only called by the thread that modifies 
+ *  the table.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+static int
+uvl_resolve_table_publish (struct resolve_table *table)  ///< Table to publish, can be NULL
+{
+    struct resolve_table *old;
+    u32_t parity;
+
+    old = g_resolve_table;
+    __sync_synchronize (); // table contents before pointer
     psvUnlockMem ();
-    g_resolve_table = base;
+    g_resolve_table = table;
     psvLockMem ();
-    g_resolve_table->block_uid = block;
-    g_resolve_table->length = 0;
+    if (old == NULL)
+    {
+        return 0;
+    }
+    // readers entering from now on see the new table
+    parity = __sync_fetch_and_add (&g_resolve_epoch->epoch, 1) & 1;
+    while (g_resolve_epoch->readers[parity] != 0)
+    {
+        sceKernelDelayThread (UVL_RESOLVE_RETIRE_WAIT);
+    }
+    if (sceKernelFreeMemBlock (old->block_uid) < 0)
+    {
+        LOG ("Error freeing resolve table.");
+        return -1;
+    }
     return 0;
 }
 
+/********************************************//**
+ *  \brief Allocates memory for resolve table.
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int 
+uvl_resolve_table_initialize ()
+{
+    struct resolve_table *table;
+    PsvUID block;
+    void *base;
+
+    if (g_resolve_epoch == NULL)
+    {
+        block = sceKernelAllocMemBlock ("UVLEpoch", 0xC20D060, 0x1000, NULL);
+        if (block < 0)
+        {
+            LOG ("Error allocating resolve epoch. 0x%08X", block);
+            return -1;
+        }
+        if (sceKernelGetMemBlockBase (block, &base) < 0)
+        {
+            LOG ("Error getting block base.");
+            return -1;
+        }
+        memset (base, 0, sizeof (struct resolve_epoch));
+        ((struct resolve_epoch*)base)->block_uid = block;
+        psvUnlockMem ();
+        g_resolve_epoch = base;
+        psvLockMem ();
+    }
+    if (uvl_resolve_table_alloc (&table) < 0)
+    {
+        return -1;
+    }
+    return uvl_resolve_table_publish (table);
+}
+
 /********************************************//**
  *  \brief Frees memory for resolve table.
  *  
+ *  Waits for any thread still looking up 
+ *  entries.
  *  \returns Zero on success, otherwise error
  ***********************************************/
 int
 uvl_resolve_table_destroy ()
 {
-    PsvUID block;
-
     if (g_resolve_table == NULL)
     {
         IF_DEBUG LOG ("Resolve table not initialized.");
         return 0;
     }
-    if (sceKernelFreeMemBlock (g_resolve_table->block_uid) < 0)
-    {
-        LOG ("Error freeing resolve table.");
-        return -1;
-    }
-    psvUnlockMem ();
-    g_resolve_table = NULL;
-    psvLockMem ();
-    return 0;
+    return uvl_resolve_table_publish (NULL);
 }
 
 /********************************************//**
  *  \brief Adds a resolve entry
  *  
  *  This function does not check for duplicates.
+ *  Readers see the entry once it is complete.
  *  \returns Zero on success, otherwise error
  ***********************************************/
 int 
@@ -105,29 +224,169 @@ uvl_resolve_table_add (resolve_entry_t *entry) ///< Entry to add
     IF_VERBOSE LOG ("Adding entry #%u to resolve table.", g_resolve_table->length);
     IF_VERBOSE LOG ("NID: 0x%08X, type: %u, value 0x%08X", entry->nid, entry->type, entry->value.value);
     memcpy (&g_resolve_table->table[g_resolve_table->length], entry, sizeof (resolve_entry_t));
+    g_resolve_table->table[g_resolve_table->length].order = (u16_t)g_resolve_table->length;
+    __sync_synchronize (); // entry before length
     g_resolve_table->length++;
     return 0;
 }
 
+/********************************************//**
+ *  \brief Finds the newest entry for a NID in 
+ *  the first @a length entries of a table
+ *  
+ *  \returns Entry on success, NULL on error
+ ***********************************************/
+static resolve_entry_t *
+uvl_resolve_table_find (struct resolve_table *table,    ///< Table to search
+                                       u32_t length,    ///< Number of entries to search
+                                       u32_t nid)       ///< NID to resolve
+{
+    int i;
+    u32_t low, high, mid;
+    // unsorted entries were added last
+    for (i = length - 1; i >= (int)table->sorted; i--)
+    {
+        if (table->table[i].nid == nid)
+        {
+            return &table->table[i];
+        }
+    }
+    // find the first sorted entry past the NID, the one before it is the newest match
+    low = 0;
+    high = table->sorted;
+    while (low < high)
+    {
+        mid = (low + high) >> 1;
+        if (table->table[mid].nid <= nid)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    if (low > 0 && table->table[low - 1].nid == nid)
+    {
+        return &table->table[low - 1];
+    }
+    return NULL;
+}
+
 /********************************************//**
  *  \brief Gets a resolve entry
  *  
  *  This function returns the last entry in the 
- *  table that has the given NID.
+ *  table that has the given NID. The entry may 
+ *  move when the table is sorted, so this is 
+ *  only for the thread that modifies the table.
+ *  Other threads should use 
+ *  @c uvl_resolve_table_lookup.
  *  \returns Entry on success, NULL on error
  ***********************************************/
 resolve_entry_t *
 uvl_resolve_table_get (u32_t nid)               ///< NID to resolve
 {
-    int i;
-    for (i = g_resolve_table->length - 1; i >= 0; i--)
+    return uvl_resolve_table_find (g_resolve_table, g_resolve_table->length, nid);
+}
+
+/********************************************//**
+ *  \brief Looks up a resolve entry from any 
+ *  thread
+ *  
+ *  Never blocks, even while entries are being 
+ *  added or the table is being replaced. The 
+ *  entry is copied out because the table it 
+ *  was found in may be freed afterwards.
+ *  \returns Zero on success, otherwise not found
+ ***********************************************/
+int
+uvl_resolve_table_lookup (u32_t nid,                ///< NID to resolve
+                resolve_entry_t *entry)             ///< Where to copy the entry to
+{
+    struct resolve_table *table;
+    resolve_entry_t *found;
+    u32_t epoch;
+    u32_t length;
+
+    if (g_resolve_epoch == NULL)
+    {
+        return -1;
+    }
+    for (;;)
+    {
+        epoch = g_resolve_epoch->epoch & 1;
+        __sync_fetch_and_add (&g_resolve_epoch->readers[epoch], 1);
+        if ((g_resolve_epoch->epoch & 1) == epoch)
+        {
+            break;
+        }
+        __sync_fetch_and_sub (&g_resolve_epoch->readers[epoch], 1); // writer moved on, retry
+    }
+    found = NULL;
+    table = *(struct resolve_table * volatile *)&g_resolve_table;
+    if (table != NULL)
     {
-        if (g_resolve_table->table[i].nid == nid)
+        length = *(volatile u32_t*)&table->length;
+        __sync_synchronize (); // length before entries
+        found = uvl_resolve_table_find (table, length, nid);
+        if (found != NULL)
         {
-            return &g_resolve_table->table[i];
+            memcpy (entry, found, sizeof (resolve_entry_t));
         }
     }
-    return NULL;
+    __sync_fetch_and_sub (&g_resolve_epoch->readers[epoch], 1);
+    return found == NULL ? -1 : 0;
+}
+
+/********************************************//**
+ *  \brief Orders resolve entries by NID then 
+ *  by insertion order
+ ***********************************************/
+static int
+uvl_resolve_entry_compare (const void *a, const void *b)
+{
+    const resolve_entry_t *x = a;
+    const resolve_entry_t *y = b;
+
+    if (x->nid != y->nid)
+    {
+        return x->nid < y->nid ? -1 : 1;
+    }
+    return (int)x->order - (int)y->order;
+}
+
+/********************************************//**
+ *  \brief Sorts the resolve table by NID
+ *  
+ *  Entries with the same NID stay in the order 
+ *  they were added so the newest one still 
+ *  takes precedence. Entries added afterwards 
+ *  are searched first until the next sort. 
+ *  The sorted copy is built in a new table and 
+ *  replaces the old one, so concurrent readers 
+ *  never see a partly sorted table.
+ ***********************************************/
+void
+uvl_resolve_table_sort ()
+{
+    struct resolve_table *sorted;
+
+    if (g_resolve_table->sorted == g_resolve_table->length)
+    {
+        return;
+    }
+    IF_DEBUG LOG ("Sorting %u resolve entries.", g_resolve_table->length);
+    if (uvl_resolve_table_alloc (&sorted) < 0)
+    {
+        LOG ("Cannot sort resolve table, lookups will be slower.");
+        return;
+    }
+    memcpy (sorted->table, g_resolve_table->table, g_resolve_table->length * sizeof (resolve_entry_t));
+    qsort (sorted->table, g_resolve_table->length, sizeof (resolve_entry_t), uvl_resolve_entry_compare);
+    sorted->length = g_resolve_table->length;
+    sorted->sorted = g_resolve_table->length;
+    uvl_resolve_table_publish (sorted);
 }
 
 // TODO: Implement this
@@ -145,6 +404,55 @@ uvl_estimate_syscall (u32_t nid) ///< NID to resolve
     return NULL;
 }
 
+/********************************************//**
+ *  \brief Reads variables a module exports 
+ *  before it is unloaded
+ *  
+ *  Variables are added as references and only 
+ *  read when a homebrew imports them. Entries 
+ *  pointing into the module's segments are read 
+ *  now so they outlive it. Entries are changed 
+ *  in place, so this must not run while 
+ *  another thread resolves.
+ *  \returns Number of entries read
+ ***********************************************/
+u32_t
+uvl_resolve_table_pin (loaded_module_info_t *m_mod_info) ///< Module about to be unloaded
+{
+    resolve_entry_t *entry;
+    resolve_entry_t *end;
+    u32_t addr;
+    u32_t count;
+    int j;
+
+    if (g_resolve_table == NULL)
+    {
+        return 0;
+    }
+    count = 0;
+    end = &g_resolve_table->table[g_resolve_table->length];
+    for (entry = g_resolve_table->table; entry < end; entry++)
+    {
+        if (entry->type != RESOLVE_TYPE_VARIABLE_REF)
+        {
+            continue;
+        }
+        addr = (u32_t)entry->value.ptr;
+        for (j = 0; j < 4; j++)
+        {
+            if (addr - (u32_t)m_mod_info->segments[j].vaddr < m_mod_info->segments[j].memsz)
+            {
+                entry->value.value = *(u32_t*)addr;
+                entry->type = RESOLVE_TYPE_VARIABLE;
+                count++;
+                break;
+            }
+        }
+    }
+    IF_DEBUG LOG ("Read %u variables from %s before unloading.", count, m_mod_info->module_name);
+    return count;
+}
+
 /********************************************//**
  *  \brief Creates resolve entry from stub 
  *  function imported by a module
@@ -162,7 +470,6 @@ uvl_resolve_import_stub_to_entry (void *stub,  ///< Stub function to read
 {
     u32_t val = 0;
     u8_t inst_type = 0;
-    int read = 0;
     entry->type = RESOLVE_TYPE_UNKNOWN;
     entry->value.value = 0;
     for (;;)
@@ -206,35 +513,35 @@ uvl_resolve_import_stub_to_entry (void *stub,  ///< Stub function to read
 }
 
 /********************************************//**
- *  \brief Fills a stub with resolve entry
+ *  \brief Fills a stub with resolve entry 
+ *  without unlocking memory
  *  
+ *  The caller unlocks memory once around a 
+ *  batch of stubs.
  *  \returns Zero on success, otherwise error
  ***********************************************/
-int
-uvl_resolve_entry_to_import_stub (resolve_entry_t *entry,   ///< Entry to read from
-                                             void *stub)    ///< Stub function to fill
+static int
+uvl_resolve_stub_write (resolve_entry_t *entry, ///< Entry to read from
+                                   void *stub)  ///< Stub function to fill
 {
     u32_t *memloc = stub;
     switch (entry->type)
     {
         case RESOLVE_TYPE_FUNCTION:
-            psvUnlockMem ();
             memloc[0] = uvl_encode_arm_inst (INSTRUCTION_MOVW, (u16_t)entry->value.value, 12);
             memloc[1] = uvl_encode_arm_inst (INSTRUCTION_MOVT, (u16_t)(entry->value.value >> 16), 12);
             memloc[2] = uvl_encode_arm_inst (INSTRUCTION_BRANCH, 0, 12);
-            psvLockMem ();
             break;
         case RESOLVE_TYPE_SYSCALL:
-            psvUnlockMem ();
             memloc[0] = uvl_encode_arm_inst (INSTRUCTION_MOVW, (u16_t)entry->value.value, 12);
             memloc[1] = uvl_encode_arm_inst (INSTRUCTION_SYSCALL, 0, 0);
             memloc[2] = uvl_encode_arm_inst (INSTRUCTION_BRANCH, 0, 14);
-            psvLockMem ();
             break;
         case RESOLVE_TYPE_VARIABLE:
-            psvUnlockMem ();
             memloc[0] = entry->value.value;
-            psvLockMem ();
+            break;
+        case RESOLVE_TYPE_VARIABLE_REF:
+            memloc[0] = *(u32_t*)entry->value.ptr;
             break;
         case RESOLVE_TYPE_UNKNOWN:
         default:
@@ -245,6 +552,23 @@ uvl_resolve_entry_to_import_stub (resolve_entry_t *entry,   ///< Entry to read f
     return 0;
 }
 
+/********************************************//**
+ *  \brief Fills a stub with resolve entry
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_resolve_entry_to_import_stub (resolve_entry_t *entry,   ///< Entry to read from
+                                             void *stub)    ///< Stub function to fill
+{
+    int ret;
+
+    psvUnlockMem ();
+    ret = uvl_resolve_stub_write (entry, stub);
+    psvLockMem ();
+    return ret;
+}
+
 /********************************************//**
  *  \brief Get an instruction's type and
  *  immediate value
@@ -379,6 +703,10 @@ uvl_encode_arm_inst (u8_t type,  ///< See defined "Supported ARM instruction typ
             // 1110 0001 0010 111111111111 0001 YYYY
             // BX Rn has 0xE12FFF1 as top bytes
             return ((u32_t)0xE12FFF1 << 4) | reg;
+        case INSTRUCTION_LOAD_PC:
+            // 1110 0101 0001 1111 1111 000000000100
+            // LDR PC, [PC, #-4] loads the word after it
+            return (u32_t)0xE51FF004;
         case INSTRUCTION_UNKNOWN:
         default:
             return 0;
@@ -428,13 +756,13 @@ uvl_resolve_add_imports (module_imports_t *imp_table,    ///< Module's import ta
     {
         return 0;
     }
-    // get variables
-    res_entry.type = RESOLVE_TYPE_VARIABLE;
+    // get variables, read when imported
+    res_entry.type = RESOLVE_TYPE_VARIABLE_REF;
     IF_VERBOSE LOG ("Found %u resolved variable imports to copy.", imp_table->num_vars);
     for(i = 0; i < imp_table->num_vars; i++)
     {
         res_entry.nid = imp_table->var_nid_table[i];
-        res_entry.value.value = *(u32_t*)imp_table->var_entry_table[i];
+        res_entry.value.ptr = imp_table->var_entry_table[i];
         if (uvl_resolve_table_add (&res_entry) < 0)
         {
             LOG ("Error adding entry to table.");
@@ -443,12 +771,12 @@ uvl_resolve_add_imports (module_imports_t *imp_table,    ///< Module's import ta
     }
     // get TLS
     // TODO: Find out how this works
-    res_entry.type = RESOLVE_TYPE_VARIABLE;
+    res_entry.type = RESOLVE_TYPE_VARIABLE_REF;
     IF_VERBOSE LOG ("Found %u resolved tls imports to copy.", imp_table->num_tls_vars);
     for(i = 0; i < imp_table->num_tls_vars; i++)
     {
         res_entry.nid = imp_table->tls_nid_table[i];
-        res_entry.value.value = *(u32_t*)imp_table->tls_entry_table[i];
+        res_entry.value.ptr = imp_table->tls_entry_table[i];
         if (uvl_resolve_table_add (&res_entry) < 0)
         {
             LOG ("Error adding entry to table.");
@@ -484,13 +812,13 @@ uvl_resolve_add_exports (module_exports_t *exp_table) ///< Module's export table
             return -1;
         }
     }
-    // get variables
-    res_entry.type = RESOLVE_TYPE_VARIABLE;
+    // get variables, read when imported
+    res_entry.type = RESOLVE_TYPE_VARIABLE_REF;
     IF_VERBOSE LOG ("Found %u resolved variable exports to copy.", exp_table->num_vars);
     for(i = 0; i < exp_table->num_vars; i++, offset++)
     {
         res_entry.nid = exp_table->nid_table[offset];
-        res_entry.value.value = *(u32_t*)exp_table->entry_table[offset];
+        res_entry.value.ptr = exp_table->entry_table[offset];
         if (uvl_resolve_table_add (&res_entry) < 0)
         {
             LOG ("Error adding entry to table.");
@@ -594,6 +922,8 @@ uvl_resolve_add_all_modules (int type) ///< An OR combination of flags (see defi
 {
     PsvUID mod_list[MAX_LOADED_MODS];
     u32_t num_loaded = MAX_LOADED_MODS;
+    snapshot_t *snapshot;
+    u32_t start;
     int i;
 
     IF_DEBUG LOG ("Getting list of loaded modules.");
@@ -603,6 +933,19 @@ uvl_resolve_add_all_modules (int type) ///< An OR combination of flags (see defi
         return -1;
     }
     IF_DEBUG LOG ("Found %u loaded modules.", num_loaded);
+    start = sceKernelGetSystemTimeLow ();
+    // syscalls come from the snapshot instead of each module's stubs
+    if ((type & RESOLVE_MOD_IMPS) && (type & RESOLVE_IMPS_SVC_ONLY))
+    {
+        if (uvl_snapshot_get (mod_list, num_loaded, &snapshot) < 0 || uvl_snapshot_add_all (snapshot) < 0)
+        {
+            LOG ("Cannot use syscall snapshot, reading syscalls of each module.");
+        }
+        else
+        {
+            type &= ~(RESOLVE_MOD_IMPS | RESOLVE_IMPS_SVC_ONLY);
+        }
+    }
     for (i = 0; i < num_loaded; i++)
     {
         if (uvl_resolve_add_module (mod_list[i], type) < 0)
@@ -611,99 +954,223 @@ uvl_resolve_add_all_modules (int type) ///< An OR combination of flags (see defi
             continue;
         }
     }
+    IF_DEBUG LOG ("Scanned %u modules into %u entries in %u us.", num_loaded, g_resolve_table->length, sceKernelGetSystemTimeLow () - start);
     return 0;
 }
 
 /********************************************//**
- *  \brief Adds entries from a loaded module to 
- *  resolve table
+ *  \brief Finds the module information of a 
+ *  loaded module
  *  
- *  This functions takes a loaded module 
- *  and attempts to read its import and/or 
- *  export table and add entries to our 
- *  resolve table.
+ *  Searches the first segment for the module 
+ *  name and checks that a valid module info 
+ *  structure surrounds it.
  *  \returns Zero on success, otherwise error
  ***********************************************/
 int
-uvl_resolve_add_module (PsvUID modid, ///< UID of the module
-                           int type)  ///< An OR combination of flags (see defined "Search flags for importing loaded modules") directing the search
+uvl_resolve_find_module_info (loaded_module_info_t *m_mod_info,  ///< Information returned by @c sceKernelGetModuleInfo
+                                     module_info_t **mod_info)   ///< Returned module info
 {
-    loaded_module_info_t m_mod_info;
-    module_info_t *mod_info;
     void *result;
     u32_t segment_size;
-    module_exports_t *exports;
-    module_imports_t *imports;
 
-    m_mod_info.size = sizeof (loaded_module_info_t); // should be 440
-    IF_VERBOSE LOG ("Getting information for module UID: 0x%X.", modid);
-    if (sceKernelGetModuleInfo (modid, &m_mod_info) < 0)
-    {
-        LOG ("Error getting info for mod 0x%08X", modid);
-        return -1;
-    }
-    IF_VERBOSE LOG ("Module: %s, file: %s", m_mod_info.module_name, m_mod_info.file_path);
-    mod_info = NULL;
-    result = m_mod_info.segments[0].vaddr;
-    segment_size = m_mod_info.segments[0].memsz;
+    *mod_info = NULL;
+    result = m_mod_info->segments[0].vaddr;
+    segment_size = m_mod_info->segments[0].memsz;
     while (segment_size > 0)
     {
-        IF_VERBOSE LOG ("Searching for module name in memory. Start 0x%X", result);
-        result = memstr (result, segment_size, m_mod_info.module_name, strlen (m_mod_info.module_name));
+        IF_VERBOSE LOG ("Searching for module name in memory. Start 0x%X", (u32_t)result);
+        result = memstr (result, segment_size, m_mod_info->module_name, strlen (m_mod_info->module_name));
         if (result == NULL)
         {
             IF_DEBUG LOG ("Cannot find module name in memory.");
             break; // not found
         }
         // try making this the one
-        mod_info = (module_info_t*)((u32_t)result - 4);
-        IF_VERBOSE LOG ("Possible module info struct at 0x%X", (u32_t)mod_info);
-        if (mod_info->modattribute == MOD_INFO_VALID_ATTR && mod_info->modversion == MOD_INFO_VALID_VER) // TODO: Better check
+        *mod_info = (module_info_t*)((u32_t)result - 4);
+        IF_VERBOSE LOG ("Possible module info struct at 0x%X", (u32_t)*mod_info);
+        if ((*mod_info)->modattribute == MOD_INFO_VALID_ATTR && (*mod_info)->modversion == MOD_INFO_VALID_VER) // TODO: Better check
         {
-            IF_VERBOSE LOG ("Module export start at 0x%X import start at 0x%X", (u32_t)mod_info->ent_top + (u32_t)m_mod_info.segments[0].vaddr, (u32_t)mod_info->stub_top + (u32_t)m_mod_info.segments[0].vaddr);
-            break; // we found it
+            IF_VERBOSE LOG ("Module export start at 0x%X import start at 0x%X", (u32_t)(*mod_info)->ent_top + (u32_t)m_mod_info->segments[0].vaddr, (u32_t)(*mod_info)->stub_top + (u32_t)m_mod_info->segments[0].vaddr);
+            return 0; // we found it
         }
         else // that string just happened to appear
         {
             IF_DEBUG LOG ("False alarm, found name is not in module info structure.");
-            mod_info = NULL;
-            segment_size -= ((u32_t)result - (u32_t)m_mod_info.segments[0].vaddr) + strlen (m_mod_info.module_name); // subtract length
-            result = (void*)((u32_t)result + strlen (m_mod_info.module_name)); // start after name
+            *mod_info = NULL;
+            segment_size -= ((u32_t)result - (u32_t)m_mod_info->segments[0].vaddr) + strlen (m_mod_info->module_name); // subtract length
+            result = (void*)((u32_t)result + strlen (m_mod_info->module_name)); // start after name
             continue;
         }
     }
-    if (mod_info == NULL)
+    LOG ("Can't get module information for %s.", m_mod_info->module_name);
+    return -1;
+}
+
+/********************************************//**
+ *  \brief Starts walking module tables
+ *  
+ *  Pointers read from the tables have @a delta 
+ *  added before what they point to is 
+ *  prefetched, for tables read from a file.
+ ***********************************************/
+void
+uvl_module_ports_begin (module_ports_iter_t *iter,  ///< Iterator to set up
+                                       void *start, ///< First table
+                                       void *end,   ///< End of the tables
+                                        int kind,   ///< See defined "Kinds of module tables"
+                                      u32_t delta)  ///< Offset from pointers in the tables to their data, or zero
+{
+    iter->next = (u32_t)start;
+    iter->end = (u32_t)end;
+    iter->delta = delta;
+    iter->kind = kind;
+    iter->min_size = kind == MODULE_PORTS_IMPORTS ? sizeof (module_imports_t) : sizeof (module_exports_t);
+    __builtin_prefetch (start);
+}
+
+/********************************************//**
+ *  \brief Checks that a table is in bounds
+ *  
+ *  \returns Size of the table, or zero if it 
+ *  does not fit
+ ***********************************************/
+static inline u32_t
+uvl_module_ports_fits (module_ports_iter_t *iter,   ///< Iterator
+                                     u32_t table)   ///< Table to check
+{
+    u32_t size;
+
+    if (table > iter->end || iter->end - table < iter->min_size)
+    {
+        return 0;
+    }
+    size = ((module_ports_t*)table)->size;
+    if (size < iter->min_size || (size & 3) != 0 || size > iter->end - table)
+    {
+        return 0;
+    }
+    return size;
+}
+
+/********************************************//**
+ *  \brief Prefetches the NID and entry arrays 
+ *  of a table
+ ***********************************************/
+static inline void
+uvl_module_ports_prefetch (module_ports_iter_t *iter,   ///< Iterator
+                                module_ports_t *table)  ///< Table to prefetch for
+{
+    if (iter->kind == MODULE_PORTS_IMPORTS)
     {
-        LOG ("Can't get module information for %s.", m_mod_info.module_name);
+        __builtin_prefetch ((void*)((u32_t)table->imports.func_nid_table + iter->delta));
+        __builtin_prefetch ((void*)((u32_t)table->imports.func_entry_table + iter->delta));
+        if (table->imports.num_vars > 0)
+        {
+            __builtin_prefetch ((void*)((u32_t)table->imports.var_nid_table + iter->delta));
+            __builtin_prefetch ((void*)((u32_t)table->imports.var_entry_table + iter->delta));
+        }
+    }
+    else
+    {
+        __builtin_prefetch ((void*)((u32_t)table->exports.nid_table + iter->delta));
+        __builtin_prefetch ((void*)((u32_t)table->exports.entry_table + iter->delta));
+    }
+}
+
+/********************************************//**
+ *  \brief Gets the next module table
+ *  
+ *  While the returned table is processed, the 
+ *  arrays of the table after it and the header 
+ *  of the one after that are prefetched. Does 
+ *  not log, so it is safe to use before the 
+ *  loader is resolved.
+ *  \returns Next table, or NULL at the end or 
+ *  at a table that does not fit
+ ***********************************************/
+module_ports_t *
+uvl_module_ports_next (module_ports_iter_t *iter)   ///< Iterator
+{
+    module_ports_t *table;
+    u32_t size;
+
+    table = (module_ports_t*)iter->next;
+    if ((size = uvl_module_ports_fits (iter, iter->next)) == 0)
+    {
+        iter->next = iter->end;
+        return NULL;
+    }
+    iter->next += size;
+    // header was prefetched by the last call
+    if ((size = uvl_module_ports_fits (iter, iter->next)) != 0)
+    {
+        uvl_module_ports_prefetch (iter, (module_ports_t*)iter->next);
+        __builtin_prefetch ((void*)(iter->next + size));
+    }
+    return table;
+}
+
+/********************************************//**
+ *  \brief Adds entries from a loaded module to
+ *  resolve table
+ *  
+ *  This functions takes a loaded module 
+ *  and attempts to read its import and/or 
+ *  export table and add entries to our 
+ *  resolve table.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_resolve_add_module (PsvUID modid, ///< UID of the module
+                           int type)  ///< An OR combination of flags (see defined "Search flags for importing loaded modules") directing the search
+{
+    loaded_module_info_t m_mod_info;
+    module_info_t *mod_info;
+    module_ports_iter_t iter;
+    module_ports_t *table;
+    u32_t base;
+
+    m_mod_info.size = sizeof (loaded_module_info_t); // should be 440
+    IF_VERBOSE LOG ("Getting information for module UID: 0x%X.", modid);
+    if (sceKernelGetModuleInfo (modid, &m_mod_info) < 0)
+    {
+        LOG ("Error getting info for mod 0x%08X", modid);
         return -1;
     }
-    if (BIT_SET (type, RESOLVE_MOD_EXPS))
+    IF_VERBOSE LOG ("Module: %s, file: %s", m_mod_info.module_name, m_mod_info.file_path);
+    if (uvl_resolve_find_module_info (&m_mod_info, &mod_info) < 0)
+    {
+        return -1;
+    }
+    base = (u32_t)m_mod_info.segments[0].vaddr;
+    if (type & RESOLVE_MOD_EXPS)
     {
         IF_VERBOSE LOG ("Adding exports to resolve table.");
-        for (exports = (module_exports_t*)((u32_t)m_mod_info.segments[0].vaddr + mod_info->ent_top); 
-            (u32_t)exports < ((u32_t)m_mod_info.segments[0].vaddr + mod_info->ent_end); exports++)
+        uvl_module_ports_begin (&iter, (void*)(base + mod_info->ent_top), (void*)(base + mod_info->ent_end), MODULE_PORTS_EXPORTS, 0);
+        while ((table = uvl_module_ports_next (&iter)) != NULL)
         {
-            if (exports->lib_name != NULL)
+            if (table->exports.lib_name != NULL)
             {
-                IF_VERBOSE LOG ("Adding exports for %s", exports->lib_name);
+                IF_VERBOSE LOG ("Adding exports for %s", table->exports.lib_name);
             }
-            if (uvl_resolve_add_exports (exports) < 0)
+            if (uvl_resolve_add_exports (&table->exports) < 0)
             {
-                LOG ("Unable to resolve exports at 0x%08X. Continuing.", (u32_t)exports);
+                LOG ("Unable to resolve exports at 0x%08X. Continuing.", (u32_t)table);
                 continue;
             }
         }
     }
-    if (BIT_SET (type, RESOLVE_MOD_IMPS))
+    if (type & RESOLVE_MOD_IMPS)
     {
         IF_VERBOSE LOG ("Adding resolved imports to resolve table.");
-        for (imports = (module_imports_t*)((u32_t)m_mod_info.segments[0].vaddr + mod_info->stub_top); 
-            (u32_t)imports < ((u32_t)m_mod_info.segments[0].vaddr + mod_info->stub_end); imports++)
+        uvl_module_ports_begin (&iter, (void*)(base + mod_info->stub_top), (void*)(base + mod_info->stub_end), MODULE_PORTS_IMPORTS, 0);
+        while ((table = uvl_module_ports_next (&iter)) != NULL)
         {
-            IF_VERBOSE LOG ("Adding imports for %s", imports->lib_name);
-            if (uvl_resolve_add_imports (imports, BIT_SET (type, RESOLVE_IMPS_SVC_ONLY)) < 0)
+            IF_VERBOSE LOG ("Adding imports for %s", table->imports.lib_name);
+            if (uvl_resolve_add_imports (&table->imports, type & RESOLVE_IMPS_SVC_ONLY) < 0)
             {
-                LOG ("Unable to resolve imports at 0x%08X. Continuing.", (u32_t)imports);
+                LOG ("Unable to resolve imports at 0x%08X. Continuing.", (u32_t)table);
                 continue;
             }
         }
@@ -712,70 +1179,408 @@ uvl_resolve_add_module (PsvUID modid, ///< UID of the module
 }
 
 /********************************************//**
- *  \brief Resolves an import table
+ *  \brief Allocates the unresolved import 
+ *  records
  *  
  *  \returns Zero on success, otherwise error
  ***********************************************/
+static int
+uvl_resolve_trap_alloc ()
+{
+    PsvUID block;
+    void *base;
+
+    block = sceKernelAllocMemBlock ("UVLTrap", 0xC20D060, (sizeof (struct resolve_trap) + 0xFFF) & ~0xFFF, NULL);
+    if (block < 0)
+    {
+        LOG ("Error allocating unresolved records. 0x%08X", block);
+        return -1;
+    }
+    if (sceKernelGetMemBlockBase (block, &base) < 0)
+    {
+        LOG ("Error getting unresolved records address.");
+        return -1;
+    }
+    memset (base, 0, sizeof (struct resolve_trap));
+    ((struct resolve_trap*)base)->block_uid = block;
+    psvUnlockMem ();
+    g_resolve_trap = base;
+    psvLockMem ();
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Notes an unresolved import for the 
+ *  report
+ *  
+ *  The NID is only logged right away if there 
+ *  is no memory to keep it.
+ ***********************************************/
+void
+uvl_resolve_trap_miss (u32_t nid,       ///< Unresolved NID
+                        char *lib_name) ///< Library imported from
+{
+    if (g_resolve_trap == NULL && uvl_resolve_trap_alloc () < 0)
+    {
+        LOG ("Cannot resolve NID: 0x%08X from %s. Continuing.", nid, lib_name);
+        return;
+    }
+    if (g_resolve_trap->num_misses < MAX_RESOLVE_MISSES)
+    {
+        g_resolve_trap->misses[g_resolve_trap->num_misses].nid = nid;
+        g_resolve_trap->misses[g_resolve_trap->num_misses].lib_name = lib_name;
+    }
+    g_resolve_trap->num_misses++;
+}
+
+/********************************************//**
+ *  \brief Called by stubs of unresolved 
+ *  functions
+ *  
+ *  The stub puts the NID in R12. The caller's 
+ *  arguments are left alone and the record 
+ *  function returns straight to the caller.
+ ***********************************************/
+static void __attribute__((naked))
+uvl_resolve_trap ()
+{
+#ifndef UVL_HOST // host tools never call the trap
+    __asm__ ("mov r0, r12\n"
+             "mov r1, lr\n"
+             "b uvl_resolve_trap_record\n");
+#endif
+}
+
+/********************************************//**
+ *  \brief Records a call to an unresolved 
+ *  function
+ *  
+ *  \returns @c UVL_RESOLVE_TRAP_ERROR
+ ***********************************************/
 int
-uvl_resolve_imports (module_imports_t *import)   ///< Import table
+uvl_resolve_trap_record (u32_t nid,     ///< NID called
+                          void *caller) ///< Return address of the call
+{
+    u32_t i;
+
+    if (g_resolve_trap != NULL)
+    {
+        i = __sync_fetch_and_add (&g_resolve_trap->num_calls, 1);
+        if (i < MAX_TRAP_CALLS)
+        {
+            g_resolve_trap->calls[i].nid = nid;
+            g_resolve_trap->calls[i].caller = caller;
+        }
+    }
+    return UVL_RESOLVE_TRAP_ERROR;
+}
+
+/********************************************//**
+ *  \brief Points an unresolved function stub 
+ *  at the trap without unlocking memory
+ ***********************************************/
+static void
+uvl_resolve_trap_write (u32_t nid,  ///< Unresolved NID
+                         void *stub) ///< Stub function to fill
+{
+    u32_t *memloc = stub;
+
+    memloc[0] = uvl_encode_arm_inst (INSTRUCTION_MOVW, (u16_t)nid, 12);
+    memloc[1] = uvl_encode_arm_inst (INSTRUCTION_MOVT, (u16_t)(nid >> 16), 12);
+    memloc[2] = uvl_encode_arm_inst (INSTRUCTION_LOAD_PC, 0, 0);
+    memloc[3] = (u32_t)uvl_resolve_trap;
+    IF_VERBOSE LOG ("Trapped NID 0x%08X at 0x%08X", nid, (u32_t)stub);
+}
+
+/********************************************//**
+ *  \brief Points an unresolved function stub 
+ *  at the trap
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_resolve_trap_stub (u32_t nid,   ///< Unresolved NID
+                        void *stub) ///< Stub function to fill
+{
+    psvUnlockMem ();
+    uvl_resolve_trap_write (nid, stub);
+    psvLockMem ();
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Orders unresolved imports by library 
+ *  name then by NID
+ ***********************************************/
+static int
+uvl_resolve_miss_compare (const void *a, const void *b)
+{
+    const struct resolve_miss *x = a;
+    const struct resolve_miss *y = b;
+    int ret;
+
+    if ((ret = strcmp (x->lib_name, y->lib_name)) != 0)
+    {
+        return ret;
+    }
+    return x->nid < y->nid ? -1 : (x->nid > y->nid);
+}
+
+/********************************************//**
+ *  \brief Logs unresolved imports by library
+ *  
+ *  Must be called while the library names of 
+ *  the resolved imports are still readable. 
+ *  Misses are sorted first, since the same 
+ *  library can be imported by more than one 
+ *  table.
+ ***********************************************/
+void
+uvl_resolve_trap_report ()
+{
+    char line[MAX_LOG_LENGTH];
+    u32_t recorded;
+    u32_t i, j;
+
+    if (g_resolve_trap == NULL || g_resolve_trap->num_misses == 0)
+    {
+        return;
+    }
+    recorded = g_resolve_trap->num_misses < MAX_RESOLVE_MISSES ? g_resolve_trap->num_misses : MAX_RESOLVE_MISSES;
+    qsort (g_resolve_trap->misses, recorded, sizeof (g_resolve_trap->misses[0]), uvl_resolve_miss_compare);
+    for (i = 0; i < recorded; i = j)
+    {
+        line[0] = '\0';
+        for (j = i; j < recorded && strcmp (g_resolve_trap->misses[j].lib_name, g_resolve_trap->misses[i].lib_name) == 0; j++)
+        {
+            if (j - i < UVL_TRAP_REPORT_NIDS)
+            {
+                sprintf (&line[strlen (line)], " 0x%08X", g_resolve_trap->misses[j].nid);
+            }
+        }
+        LOG ("%u unresolved from %s:%s%s", j - i, g_resolve_trap->misses[i].lib_name, line, j - i > UVL_TRAP_REPORT_NIDS ? " ..." : "");
+    }
+    if (g_resolve_trap->num_misses > recorded)
+    {
+        LOG ("%u more unresolved not recorded.", g_resolve_trap->num_misses - recorded);
+    }
+    g_resolve_trap->num_misses = 0;
+}
+
+/********************************************//**
+ *  \brief Logs calls made to unresolved 
+ *  functions
+ ***********************************************/
+void
+uvl_resolve_trap_dump ()
+{
+    u32_t count;
+    u32_t i;
+
+    if (g_resolve_trap == NULL || g_resolve_trap->num_calls == 0)
+    {
+        return;
+    }
+    count = g_resolve_trap->num_calls;
+    LOG ("%u calls to unresolved functions.", count);
+    for (i = 0; i < count && i < MAX_TRAP_CALLS; i++)
+    {
+        LOG ("NID 0x%08X called from 0x%08X", g_resolve_trap->calls[i].nid, (u32_t)g_resolve_trap->calls[i].caller);
+    }
+}
+
+/********************************************//**
+ *  \brief Orders import slots by NID
+ ***********************************************/
+static int
+uvl_import_slot_compare_nid (const void *a, const void *b)
+{
+    u32_t x = ((const import_slot_t*)a)->nid;
+    u32_t y = ((const import_slot_t*)b)->nid;
+
+    return x < y ? -1 : (x > y);
+}
+
+/********************************************//**
+ *  \brief Orders import slots by stub address
+ ***********************************************/
+static int
+uvl_import_slot_compare_stub (const void *a, const void *b)
+{
+    u32_t x = (u32_t)((const import_slot_t*)a)->stub;
+    u32_t y = (u32_t)((const import_slot_t*)b)->stub;
+
+    return x < y ? -1 : (x > y);
+}
+
+/********************************************//**
+ *  \brief Copies NIDs of an import table to 
+ *  import slots
+ *  
+ *  \returns Number of slots filled
+ ***********************************************/
+static inline u32_t
+uvl_import_slots_fill (import_slot_t *slots,    ///< Where to write slots
+                               u32_t *nid_table, ///< NIDs to copy
+                                void **entry_table, ///< Parallel stubs to copy
+                                 u32_t count,   ///< Number of NIDs
+                                 u32_t type)    ///< Type of the imports
+{
+    u32_t i;
+    for (i = 0; i < count; i++)
+    {
+        slots[i].nid = nid_table[i];
+        slots[i].stub = entry_table[i];
+        slots[i].resolve = NULL;
+        slots[i].type = type;
+    }
+    return count;
+}
+
+/********************************************//**
+ *  \brief Resolves an import table one NID 
+ *  at a time
+ *  
+ *  Used when the table is too large to be 
+ *  resolved in a batch. Misses are recorded 
+ *  first, recording may allocate and lock 
+ *  memory, then every stub is written with 
+ *  memory unlocked once.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+static int
+uvl_resolve_imports_each (u32_t *nid_table,     ///< NIDs to resolve
+                          void **entry_table,   ///< Parallel stubs to patch
+                          u32_t count,          ///< Number of NIDs
+                          u32_t type,           ///< Type of the imports
+                           char *lib_name)      ///< Library imported from
 {
     u32_t i;
     resolve_entry_t *resolve;
     u32_t *stub;
 
-    IF_DEBUG LOG ("Resolving import table at 0x%08X", (u32_t)import);
-    for (i = 0; i < import->num_functions; i++)
+    for (i = 0; i < count; i++)
     {
-        IF_VERBOSE LOG ("Trying to resolve function NID: 0x%08X found in %s", import->func_nid_table[i], import->lib_name);
-        resolve = uvl_resolve_table_get (import->func_nid_table[i]);
-        stub = import->func_entry_table[i];
+        if (uvl_resolve_table_get (nid_table[i]) == NULL)
+        {
+            uvl_resolve_trap_miss (nid_table[i], lib_name);
+        }
+    }
+    psvUnlockMem ();
+    for (i = 0; i < count; i++)
+    {
+        IF_VERBOSE LOG ("Trying to resolve NID: 0x%08X found in %s", nid_table[i], lib_name);
+        resolve = uvl_resolve_table_get (nid_table[i]);
+        stub = entry_table[i];
         IF_VERBOSE LOG ("Stub located at: 0x%08X", (u32_t)stub);
         if (resolve == NULL)
         {
-            LOG ("Cannot resolve NID: 0x%08X. Continuing.", import->func_nid_table[i]);
+            if (type == RESOLVE_TYPE_FUNCTION)
+            {
+                uvl_resolve_trap_write (nid_table[i], stub);
+            }
             continue;
         }
-        if (uvl_resolve_entry_to_import_stub (resolve, stub) < 0)
+        if (uvl_resolve_stub_write (resolve, stub) < 0)
         {
+            psvLockMem ();
             LOG ("Cannot write to stub 0x%08X", (u32_t)stub);
             return -1;
         }
+    }
+    psvLockMem ();
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Resolves an import table
+ *  
+ *  All NIDs of the table are sorted and 
+ *  merge-joined against the sorted resolve 
+ *  table in one pass, then the stubs are 
+ *  patched in address order with memory 
+ *  unlocked once.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_resolve_imports (module_imports_t *import)   ///< Import table
+{
+    import_slot_t *slots;
+    resolve_entry_t *table;
+    u32_t count, resolved, missed;
+    u32_t i, j, k;
 
+    IF_DEBUG LOG ("Resolving import table at 0x%08X", (u32_t)import);
+    count = import->num_functions + import->num_vars + import->num_tls_vars;
+    uvl_resolve_table_sort ();
+    if (count > MAX_IMPORT_SLOTS || g_resolve_table->sorted != g_resolve_table->length)
+    {
+        IF_DEBUG LOG ("Cannot batch %u imports, resolving one at a time.", count);
+        if (uvl_resolve_imports_each (import->func_nid_table, import->func_entry_table, import->num_functions, RESOLVE_TYPE_FUNCTION, import->lib_name) < 0 ||
+            uvl_resolve_imports_each (import->var_nid_table, import->var_entry_table, import->num_vars, RESOLVE_TYPE_VARIABLE, import->lib_name) < 0 ||
+            uvl_resolve_imports_each (import->tls_nid_table, import->tls_entry_table, import->num_tls_vars, RESOLVE_TYPE_VARIABLE, import->lib_name) < 0)
+        {
+            return -1;
+        }
+        return 0;
     }
-    for (i = 0; i < import->num_vars; i++)
+
+    slots = IMPORT_SLOTS;
+    count = 0;
+    count += uvl_import_slots_fill (&slots[count], import->func_nid_table, import->func_entry_table, import->num_functions, RESOLVE_TYPE_FUNCTION);
+    count += uvl_import_slots_fill (&slots[count], import->var_nid_table, import->var_entry_table, import->num_vars, RESOLVE_TYPE_VARIABLE);
+    count += uvl_import_slots_fill (&slots[count], import->tls_nid_table, import->tls_entry_table, import->num_tls_vars, RESOLVE_TYPE_VARIABLE);
+    qsort (slots, count, sizeof (import_slot_t), uvl_import_slot_compare_nid);
+
+    // merge-join, the last entry of a run of equal NIDs is the newest
+    table = g_resolve_table->table;
+    resolved = 0;
+    missed = 0;
+    for (i = 0, j = 0; i < count; i++)
     {
-        IF_VERBOSE LOG ("Trying to resolve variable NID: 0x%08X found in %s", import->var_nid_table[i], import->lib_name);
-        resolve = uvl_resolve_table_get (import->var_nid_table[i]);
-        stub = import->var_entry_table[i];
-        IF_VERBOSE LOG ("Stub located at: 0x%08X", (u32_t)stub);
-        if (resolve == NULL)
+        while (j < g_resolve_table->length && table[j].nid < slots[i].nid)
         {
-            LOG ("Cannot resolve NID: 0x%08X. Continuing.", import->var_nid_table[i]);
-            continue;
+            j++;
         }
-        if (uvl_resolve_entry_to_import_stub (resolve, stub) < 0)
+        if (j >= g_resolve_table->length || table[j].nid != slots[i].nid)
         {
-            LOG ("Cannot write to stub 0x%08X", (u32_t)stub);
-            return -1;
+            uvl_resolve_trap_miss (slots[i].nid, import->lib_name);
+            missed++;
+            if (slots[i].type != RESOLVE_TYPE_FUNCTION)
+            {
+                continue;
+            }
+            slots[resolved] = slots[i];
+            slots[resolved].resolve = NULL; // trap
+            resolved++;
+            continue;
         }
+        for (k = j; k + 1 < g_resolve_table->length && table[k + 1].nid == slots[i].nid; k++);
+        slots[resolved] = slots[i];
+        slots[resolved].resolve = &table[k];
+        resolved++;
     }
-    for (i = 0; i < import->num_tls_vars; i++)
+
+    // patch in stub order, unresolved functions go to the trap
+    IF_DEBUG LOG ("Resolved %u of %u imports from %s", count - missed, count, import->lib_name);
+    qsort (slots, resolved, sizeof (import_slot_t), uvl_import_slot_compare_stub);
+    psvUnlockMem ();
+    for (i = 0; i < resolved; i++)
     {
-        IF_VERBOSE LOG ("Trying to resolve tls NID: 0x%08X found in %s", import->tls_nid_table[i], import->lib_name);
-        resolve = uvl_resolve_table_get (import->tls_nid_table[i]);
-        stub = import->tls_entry_table[i];
-        IF_VERBOSE LOG ("Stub located at: 0x%08X", (u32_t)stub);
-        if (resolve == NULL)
+        IF_VERBOSE LOG ("Stub for NID 0x%08X located at: 0x%08X", slots[i].nid, (u32_t)slots[i].stub);
+        if (slots[i].resolve == NULL)
         {
-            LOG ("Cannot resolve NID: 0x%08X. Continuing.", import->tls_nid_table[i]);
+            uvl_resolve_trap_write (slots[i].nid, slots[i].stub);
             continue;
         }
-        if (uvl_resolve_entry_to_import_stub (resolve, stub) < 0)
+        if (uvl_resolve_stub_write (slots[i].resolve, slots[i].stub) < 0)
         {
-            LOG ("Cannot write to stub 0x%08X", (u32_t)stub);
+            psvLockMem ();
+            LOG ("Cannot write to stub 0x%08X", (u32_t)slots[i].stub);
             return -1;
         }
     }
+    psvLockMem ();
     return 0;
 }
 
@@ -793,9 +1598,11 @@ uvl_resolve_loader (u32_t nid, void *libkernel_base, void *stub)
 {
     void *result;
     module_info_t *mod_info;
+    module_ports_iter_t iter;
+    module_ports_t *table;
     module_exports_t *exports;
     module_imports_t *imports;
-    u32_t i;
+    int i;
 
     //LOG ("Resolving 0x%08X for 0x%08X", nid, (u32_t)stub);
 
@@ -804,38 +1611,34 @@ uvl_resolve_loader (u32_t nid, void *libkernel_base, void *stub)
     mod_info = (module_info_t*)((u32_t)result - 4);
 
     // look in exports
-    for (exports = (module_exports_t*)((u32_t)libkernel_base + mod_info->ent_top); 
-            (u32_t)exports < ((u32_t)libkernel_base + mod_info->ent_end); exports++)
+    uvl_module_ports_begin (&iter, (void*)((u32_t)libkernel_base + mod_info->ent_top), (void*)((u32_t)libkernel_base + mod_info->ent_end), MODULE_PORTS_EXPORTS, 0);
+    while ((table = uvl_module_ports_next (&iter)) != NULL)
     {
-        for (i = 0; i < exports->num_functions; i++)
+        exports = &table->exports;
+        if ((i = nid_find (exports->nid_table, exports->num_functions, &nid, 1)) != -1)
         {
-            if (exports->nid_table[i] == nid)
-            {
-                //LOG ("Resolved at export 0x%08X", (u32_t)exports->entry_table[i]);
-                psvUnlockMem ();
-                ((u32_t*)stub)[0] = uvl_encode_arm_inst (INSTRUCTION_MOVW, (u16_t)(u32_t)exports->entry_table[i], 12);
-                ((u32_t*)stub)[1] = uvl_encode_arm_inst (INSTRUCTION_MOVT, (u16_t)((u32_t)exports->entry_table[i] >> 16), 12);
-                ((u32_t*)stub)[2] = uvl_encode_arm_inst (INSTRUCTION_BRANCH, 0, 12);
-                psvLockMem ();
-                return 0;
-            }
+            //LOG ("Resolved at export 0x%08X", (u32_t)exports->entry_table[i]);
+            psvUnlockMem ();
+            ((u32_t*)stub)[0] = uvl_encode_arm_inst (INSTRUCTION_MOVW, (u16_t)(u32_t)exports->entry_table[i], 12);
+            ((u32_t*)stub)[1] = uvl_encode_arm_inst (INSTRUCTION_MOVT, (u16_t)((u32_t)exports->entry_table[i] >> 16), 12);
+            ((u32_t*)stub)[2] = uvl_encode_arm_inst (INSTRUCTION_BRANCH, 0, 12);
+            psvLockMem ();
+            return 0;
         }
     }
 
     // look in imports
-    for (imports = (module_imports_t*)((u32_t)libkernel_base + mod_info->stub_top); 
-            (u32_t)imports < ((u32_t)libkernel_base + mod_info->stub_end); imports++)
+    uvl_module_ports_begin (&iter, (void*)((u32_t)libkernel_base + mod_info->stub_top), (void*)((u32_t)libkernel_base + mod_info->stub_end), MODULE_PORTS_IMPORTS, 0);
+    while ((table = uvl_module_ports_next (&iter)) != NULL)
     {
-        for (i = 0; i < imports->num_functions; i++)
+        imports = &table->imports;
+        if ((i = nid_find (imports->func_nid_table, imports->num_functions, &nid, 1)) != -1)
         {
-            if (imports->func_nid_table[i] == nid)
-            {
-                //LOG ("Resolved at import 0x%08X", (u32_t)imports->func_entry_table[i]);
-                psvUnlockMem ();
-                memcpy (stub, imports->func_entry_table[i], STUB_FUNC_SIZE);
-                psvLockMem ();
-                return 0;
-            }
+            //LOG ("Resolved at import 0x%08X", (u32_t)imports->func_entry_table[i]);
+            psvUnlockMem ();
+            memcpy (stub, imports->func_entry_table[i], STUB_FUNC_SIZE);
+            psvLockMem ();
+            return 0;
         }
     }
 
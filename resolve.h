@@ -17,6 +17,7 @@
 #define RESOLVE_TYPE_FUNCTION   1       ///< Function call
 #define RESOLVE_TYPE_SYSCALL    2       ///< Syscall
 #define RESOLVE_TYPE_VARIABLE   3       ///< Imported variable
+#define RESOLVE_TYPE_VARIABLE_REF 4     ///< Imported variable not read yet, value is its address
 /** @}*/
 
 /** \name Supported ARM instruction types
@@ -27,6 +28,7 @@
 #define INSTRUCTION_MOVT        2       ///< MOVT Rd, \#imm instruction
 #define INSTRUCTION_SYSCALL     3       ///< SVC \#imm instruction
 #define INSTRUCTION_BRANCH      4       ///< BX Rn instruction
+#define INSTRUCTION_LOAD_PC     5       ///< LDR PC, [PC, \#-4] instruction
 /** @}*/
 
 #define STUB_FUNC_MAX_LEN       16      ///< Max size for a stub function in bytes
@@ -49,7 +51,15 @@
 
 #define MAX_LOADED_MODS         128     ///< Maximum number of loaded modules
 #define MAX_RESOLVE_ENTRIES     0x10000 ///< Maximum number of resolves
+#define UVL_RESOLVE_RETIRE_WAIT 100     ///< Microseconds to wait between checks for readers of a replaced table
+#define MAX_IMPORT_SLOTS        0x1000  ///< Maximum number of NIDs in one import table resolved in a batch
 #define STUB_FUNC_SIZE          0x10    ///< Size of stub functions
+#define MAX_RESOLVE_MISSES      0x400   ///< Maximum number of unresolved imports kept for the report
+#define MAX_TRAP_CALLS          0x100   ///< Maximum number of calls to unresolved imports recorded
+#define UVL_TRAP_REPORT_NIDS    8       ///< NIDs listed per library in the unresolved report
+#ifndef UVL_RESOLVE_TRAP_ERROR
+#define UVL_RESOLVE_TRAP_ERROR  0x80010058  ///< Returned by unresolved functions, ENOSYS
+#endif
 #define UVL_LIBKERN_BASE        0xE0000000   ///< sceLibKernel is where we import API calls from
 #define UVL_LIBKERN_MAX_SIZE    0xE000  ///< Maximum size of sceLibKernel (for resolving loader)
 
@@ -64,7 +74,7 @@ typedef struct resolve_entry
 {
     u32_t   nid;            ///< NID of entry
     u16_t   type;           ///< See defined "Type of entry"
-    u16_t   reserved;       ///< For future use
+    u16_t   order;          ///< Insertion order in the resolve table, breaks ties when sorting
     /**
      * \brief Value of the entry
      */
@@ -166,6 +176,32 @@ typedef union module_ports
     module_exports_t  exports;    ///< Export kind
 } module_ports_t;
 
+/** \name Kinds of module tables
+ *  \sa uvl_module_ports_begin
+ *  @{
+ */
+#define MODULE_PORTS_EXPORTS    0       ///< Walk @c module_exports_t tables
+#define MODULE_PORTS_IMPORTS    1       ///< Walk @c module_imports_t tables
+/** @}*/
+
+/**
+ * \brief Walks an array of module export or 
+ * import tables
+ * 
+ * Tables are stepped by their own @c size 
+ * since it differs between firmwares. The 
+ * walk stops at the first table that does 
+ * not fit.
+ */
+typedef struct module_ports_iter
+{
+    u32_t           next;       ///< Next table to return
+    u32_t           end;        ///< End of the tables
+    u32_t           delta;      ///< Added to pointers in the tables to prefetch what they point to
+    u16_t           min_size;   ///< Smallest valid table size
+    u16_t           kind;       ///< See defined "Kinds of module tables"
+} module_ports_iter_t;
+
 /**
  * \brief A segment of the module in memory
  */
@@ -213,6 +249,9 @@ int uvl_resolve_table_initialize ();
 int uvl_resolve_table_destroy ();
 int uvl_resolve_table_add (resolve_entry_t *entry);
 resolve_entry_t *uvl_resolve_table_get (u32_t nid);
+int uvl_resolve_table_lookup (u32_t nid, resolve_entry_t *entry);
+void uvl_resolve_table_sort ();
+u32_t uvl_resolve_table_pin (loaded_module_info_t *m_mod_info);
 /** @}*/
 /** \name Estimating syscalls
  *  @{
@@ -225,6 +264,15 @@ resolve_entry_t *uvl_estimate_syscall (u32_t nid);
 int uvl_resolve_import_stub_to_entry (void *stub, u32_t nid, resolve_entry_t *entry);
 int uvl_resolve_entry_to_import_stub (resolve_entry_t *entry, void *stub);
 /** @}*/
+/** \name Unresolved imports
+ *  @{
+ */
+void uvl_resolve_trap_miss (u32_t nid, char *lib_name);
+int uvl_resolve_trap_stub (u32_t nid, void *stub);
+int uvl_resolve_trap_record (u32_t nid, void *caller);
+void uvl_resolve_trap_report ();
+void uvl_resolve_trap_dump ();
+/** @}*/
 /** \name ARM instruction functions
  *  @{
  */
@@ -242,9 +290,16 @@ int uvl_resolve_add_exports (module_exports_t *exp_table);
  */
 int uvl_resolve_add_all_modules (int type);
 int uvl_resolve_add_module (PsvUID modid, int type);
+int uvl_resolve_find_module_info (loaded_module_info_t *m_mod_info, module_info_t **mod_info);
 int uvl_resolve_imports (module_imports_t *import);
 int uvl_resolve_loader (u32_t nid, void *libkernel_base, void *stub);
 /** @}*/
+/** \name Walking module tables
+ *  @{
+ */
+void uvl_module_ports_begin (module_ports_iter_t *iter, void *start, void *end, int kind, u32_t delta);
+module_ports_t *uvl_module_ports_next (module_ports_iter_t *iter);
+/** @}*/
 
 // live resolving too slow
 #if 0
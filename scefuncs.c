@@ -18,6 +18,7 @@
 #include "config.h"
 #include "resolve.h"
 #include "scefuncs.h"
+#include "utils.h"
 
 /********************************************//**
  *  \brief Resolves UVLoader
@@ -30,7 +31,7 @@
 void
 uvl_scefuncs_resolve_loader ()
 {
-    #define RESOLVE_STUB(_stub, _nid) uvl_resolve_loader (_nid, (void*)UVL_LIBKERN_BASE, _stub);
+    #define RESOLVE_STUB(_stub, _nid) uvl_resolve_loader (_nid, (void*)UVL_LIBKERN_BASE, STUB_NAME(_stub));
 
     RESOLVE_STUB(sceKernelStopUnloadModule, 0x2415F8A4);
     RESOLVE_STUB(sceKernelFindMemBlockByAddr, 0xA33B99D1);
@@ -38,14 +39,161 @@ uvl_scefuncs_resolve_loader ()
     RESOLVE_STUB(sceKernelGetMemBlockBase, 0xB8EF5818);
     RESOLVE_STUB(sceKernelAllocMemBlock, 0xB9D5EBDE);
     RESOLVE_STUB(sceKernelExitDeleteThread, 0x1D17DECF);
+    RESOLVE_STUB(sceKernelDelayThread, 0x4B675D05);
     RESOLVE_STUB(sceKernelGetModuleList, 0x2EF2581F);
     RESOLVE_STUB(sceKernelGetModuleInfo, 0x36585DAF);
     RESOLVE_STUB(sceIoWrite, 0x34EFD876);
     RESOLVE_STUB(sceIoClose, 0xC70B8886);
     RESOLVE_STUB(sceIoRead, 0xFDB32293);
+    RESOLVE_STUB(sceIoLseek, 0x99BA173E);
     RESOLVE_STUB(sceIoOpen, 0x6C60AC61);
+    RESOLVE_STUB(sceIoDopen, 0xA9283DD0);
+    RESOLVE_STUB(sceIoDread, 0x9C8B6624);
+    RESOLVE_STUB(sceIoDclose, 0x422A221A);
+    RESOLVE_STUB(sceIoGetstat, 0xBCA5B623);
+    RESOLVE_STUB(sceIoMkdir, 0x9670D39F);
     RESOLVE_STUB(sceKernelStartThread, 0xF08DE149);
     RESOLVE_STUB(sceKernelCreateThread, 0xC5C11EE7);
+    RESOLVE_STUB(sceKernelDeleteThread, 0x1BBDE3D9);
+    RESOLVE_STUB(sceKernelWaitThreadEnd, 0xDDB395A9);
+    RESOLVE_STUB(sceKernelGetSystemTimeLow, 0x47F6DE49);
 
     #undef RESOLVE_STUB
 }
+
+/********************************************//**
+ *  \brief Resolves the display functions
+ *  
+ *  SceDisplay is not part of sceLibKernel, so 
+ *  its stub is resolved from the resolve table 
+ *  once the loaded modules are added.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_scefuncs_resolve_display ()
+{
+    resolve_entry_t *entry;
+
+    entry = uvl_resolve_table_get (DISPLAY_GET_FRAME_BUF_NID);
+    if (entry == NULL)
+    {
+        IF_DEBUG LOG ("No loaded module exports sceDisplayGetFrameBuf.");
+        return -1;
+    }
+    return uvl_resolve_entry_to_import_stub (entry, STUB_NAME(sceDisplayGetFrameBuf));
+}
+
+#ifdef UVL_STATS
+/** Per function statistics, in their own block */
+sce_stats_t *g_sce_stats = NULL;
+
+#define STATS_NAME(type, name, params, args) #name,
+static const char *g_sce_stats_names[UVL_STATS_COUNT] = { UVL_SCE_FUNCTIONS(STATS_NAME) };
+
+/********************************************//**
+ *  \brief Allocates the statistics
+ *  
+ *  Calls made before this are not counted.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_stats_init ()
+{
+    PsvUID block;
+    void *base;
+
+    block = uvl_stub_sceKernelAllocMemBlock ("UVLStats", 0xC20D060, (UVL_STATS_COUNT * sizeof (sce_stats_t) + 0xFFF) & ~0xFFF, NULL);
+    if (block < 0)
+    {
+        LOG ("Cannot allocate statistics. 0x%08X", block);
+        return -1;
+    }
+    if (uvl_stub_sceKernelGetMemBlockBase (block, &base) < 0)
+    {
+        LOG ("Cannot get statistics address.");
+        return -1;
+    }
+    memset (base, 0, UVL_STATS_COUNT * sizeof (sce_stats_t));
+    psvUnlockMem ();
+    g_sce_stats = base;
+    psvLockMem ();
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Records one call
+ ***********************************************/
+static void
+uvl_stats_record (u32_t index,  ///< Function called
+                  u32_t time)   ///< Time taken in microseconds
+{
+    sce_stats_t *stats;
+    u32_t bucket;
+    u32_t max;
+
+    if (g_sce_stats == NULL)
+    {
+        return;
+    }
+    stats = &g_sce_stats[index];
+    bucket = time == 0 ? 0 : 32 - __builtin_clz (time);
+    if (bucket >= UVL_STATS_BUCKETS)
+    {
+        bucket = UVL_STATS_BUCKETS - 1;
+    }
+    // unload runs on several threads
+    __sync_fetch_and_add (&stats->count, 1);
+    __sync_fetch_and_add (&stats->total, time);
+    __sync_fetch_and_add (&stats->buckets[bucket], 1);
+    while ((max = stats->max) < time && !__sync_bool_compare_and_swap (&stats->max, max, time));
+}
+
+/********************************************//**
+ *  \brief Writes statistics to the log
+ ***********************************************/
+void
+uvl_stats_dump (const char *when) ///< Where the dump was made, for the log
+{
+    char line[MAX_LOG_LENGTH];
+    sce_stats_t *stats;
+    u32_t i, j;
+
+    if (g_sce_stats == NULL)
+    {
+        return;
+    }
+    LOG ("SCE call statistics at %s:", when);
+    for (i = 0; i < UVL_STATS_COUNT; i++)
+    {
+        stats = &g_sce_stats[i];
+        if (stats->count == 0)
+        {
+            continue;
+        }
+        line[0] = '\0';
+        for (j = 0; j < UVL_STATS_BUCKETS; j++)
+        {
+            if (stats->buckets[j] > 0)
+            {
+                sprintf (&line[strlen (line)], " %u:%u", j, stats->buckets[j]);
+            }
+        }
+        LOG ("%s: %u calls, %u us total, %u us max", g_sce_stats_names[i], stats->count, stats->total, stats->max);
+        LOG ("%s: log2 us buckets%s", g_sce_stats_names[i], line);
+    }
+}
+
+/** Wraps a stub with a counter and timer, with the 
+ *  parameters of the function it wraps. */
+#define STATS_WRAPPER(type, name, params, args) \
+    type name params \
+    { \
+        u32_t start; \
+        type ret; \
+        start = uvl_stub_sceKernelGetSystemTimeLow (); \
+        ret = uvl_stub_##name args; \
+        uvl_stats_record (UVL_STATS_##name, uvl_stub_sceKernelGetSystemTimeLow () - start); \
+        return ret; \
+    }
+UVL_SCE_FUNCTIONS(STATS_WRAPPER)
+#endif
@@ -26,6 +26,63 @@
 #define PSP2_STM_XUSR    00100
 #define PSP2_STM_RWU     (PSP2_STM_RUSR | PSP2_STM_WUSR)
 #define PSP2_STM_RU      (PSP2_STM_RUSR)
+#define PSP2_S_IFMT      0xF000
+#define PSP2_S_IFDIR     0x1000
+#define PSP2_S_IFREG     0x2000
+/** @}*/
+
+/** \name IO Structures
+ *  \todo Use toolchain
+ *  @{
+*/
+typedef struct PsvDateTime
+{
+    u16_t   year;
+    u16_t   month;
+    u16_t   day;
+    u16_t   hour;
+    u16_t   minute;
+    u16_t   second;
+    u32_t   microsecond;
+} PsvDateTime;
+
+typedef struct PsvIoStat
+{
+    int     st_mode;            ///< See @c PSP2_S_IFMT
+    u32_t   st_attr;
+    u64_t   st_size;            ///< Size in bytes
+    PsvDateTime st_ctime;       ///< Creation time
+    PsvDateTime st_atime;       ///< Access time
+    PsvDateTime st_mtime;       ///< Modification time
+    u32_t   st_private[6];
+} PsvIoStat;
+
+typedef struct PsvIoDirent
+{
+    PsvIoStat d_stat;           ///< Status of the entry
+    char    d_name[256];        ///< Name of the entry
+    void    *d_private;
+    int     dummy;
+} PsvIoDirent;
+/** @}*/
+
+/** \name Display
+ *  \todo Use toolchain
+ *  @{
+*/
+#define PSP2_DISPLAY_PIXELFORMAT_A8B8G8R8   0
+#define PSP2_DISPLAY_SETBUF_NEXTFRAME       1
+#define DISPLAY_GET_FRAME_BUF_NID           0xEEDA2E54  ///< sceDisplayGetFrameBuf, not in sceLibKernel
+
+typedef struct PsvDisplayFrameBuf
+{
+    u32_t   size;               ///< Size of this structure
+    void    *base;              ///< Framebuffer
+    u32_t   pitch;              ///< Pixels per line
+    u32_t   pixelformat;        ///< See @c PSP2_DISPLAY_PIXELFORMAT_A8B8G8R8
+    u32_t   width;              ///< Width in pixels
+    u32_t   height;             ///< Height in pixels
+} PsvDisplayFrameBuf;
 /** @}*/
 
 #ifdef GENERATE_STUBS
@@ -41,9 +98,24 @@
 #define STUB_FUNCTION_FILLED(type, name, high, low) type __attribute__((naked)) name ()
 #endif
 
-#ifdef GENERATE_STUBS
-#define STUB_FUNCTION(type, name) \
-    type __attribute__((naked, section(".sceStub.text.uvl"))) name () \
+/** \name Statistics
+ *  Build with @c UVL_STATS to count and time 
+ *  every call made through the stubs.
+ *  @{
+ */
+#ifdef UVL_STATS
+#define STUB_NAME(name) uvl_stub_##name     ///< Stubs are called through a wrapper of the same name
+#else
+#define STUB_NAME(name) name                ///< Stubs are called directly
+#endif
+#define UVL_STATS_BUCKETS   16              ///< Latency buckets, bucket @c n counts calls under 2^n microseconds
+/** @}*/
+
+#if defined (UVL_HOST)
+#define STUB_FUNCTION(type, name, params) type STUB_NAME(name) params  ///< Host tools define the imports
+#elif defined (GENERATE_STUBS)
+#define STUB_FUNCTION(type, name, params) \
+    type __attribute__((naked, section(".sceStub.text.uvl"))) STUB_NAME(name) params \
     { \
         __asm__ ("movw r0, #0xffff\n" \
                  "movt r0, #0xffff\n" \
@@ -51,26 +123,79 @@
                  "nop"); \
     }
 #else
-#define STUB_FUNCTION(type, name) type __attribute__((naked)) name ()
+#define STUB_FUNCTION(type, name, params) type __attribute__((naked)) STUB_NAME(name) params
 #endif
 
-
+/** \brief All imported functions
+ *  
+ *  Calls @a FUNC with the return type, name, 
+ *  parameter list and argument list of each 
+ *  function.
+ */
 // some names from https://github.com/pspdev/pspsdk
-STUB_FUNCTION(int, sceKernelStopUnloadModule);
-STUB_FUNCTION(int, sceKernelFindMemBlockByAddr);
-STUB_FUNCTION(int, sceKernelFreeMemBlock);
-STUB_FUNCTION(int, sceKernelGetMemBlockBase);
-STUB_FUNCTION(int, sceKernelAllocMemBlock);
-STUB_FUNCTION(int, sceKernelExitDeleteThread);
-STUB_FUNCTION(int, sceKernelGetModuleList);
-STUB_FUNCTION(int, sceKernelGetModuleInfo);
-STUB_FUNCTION(PsvSSize, sceIoWrite);
-STUB_FUNCTION(int, sceIoClose);
-STUB_FUNCTION(PsvOff, sceIoRead);
-STUB_FUNCTION(PsvUID, sceIoOpen);
-STUB_FUNCTION(int, sceKernelStartThread);
-STUB_FUNCTION(PsvUID, sceKernelCreateThread);
+#define UVL_SCE_FUNCTIONS(FUNC) \
+    FUNC(int, sceKernelStopUnloadModule, (PsvUID modid, u32_t arglen, void *argp, int flags, void *opt, int *status), (modid, arglen, argp, flags, opt, status)) \
+    FUNC(PsvUID, sceKernelFindMemBlockByAddr, (const void *addr, u32_t size), (addr, size)) \
+    FUNC(int, sceKernelFreeMemBlock, (PsvUID uid), (uid)) \
+    FUNC(int, sceKernelGetMemBlockBase, (PsvUID uid, void **base), (uid, base)) \
+    FUNC(PsvUID, sceKernelAllocMemBlock, (const char *name, int type, u32_t size, void *opt), (name, type, size, opt)) \
+    FUNC(int, sceKernelExitDeleteThread, (int status), (status)) \
+    FUNC(int, sceKernelDelayThread, (u32_t delay), (delay)) \
+    FUNC(int, sceKernelGetModuleList, (int flags, PsvUID *modids, u32_t *num), (flags, modids, num)) \
+    FUNC(int, sceKernelGetModuleInfo, (PsvUID modid, void *info), (modid, info)) \
+    FUNC(PsvSSize, sceIoWrite, (PsvUID fd, const void *data, u32_t size), (fd, data, size)) \
+    FUNC(int, sceIoClose, (PsvUID fd), (fd)) \
+    FUNC(PsvOff, sceIoRead, (PsvUID fd, void *data, u32_t size), (fd, data, size)) \
+    FUNC(PsvOff, sceIoLseek, (PsvUID fd, u64_t offset, int whence), (fd, offset, whence)) \
+    FUNC(PsvUID, sceIoOpen, (const char *file, int flags, int mode), (file, flags, mode)) \
+    FUNC(PsvUID, sceIoDopen, (const char *dir), (dir)) \
+    FUNC(int, sceIoDread, (PsvUID fd, PsvIoDirent *dir), (fd, dir)) \
+    FUNC(int, sceIoDclose, (PsvUID fd), (fd)) \
+    FUNC(int, sceIoGetstat, (const char *file, PsvIoStat *stat), (file, stat)) \
+    FUNC(int, sceIoMkdir, (const char *dir, int mode), (dir, mode)) \
+    FUNC(int, sceKernelStartThread, (PsvUID thid, u32_t arglen, void *argp), (thid, arglen, argp)) \
+    FUNC(PsvUID, sceKernelCreateThread, (const char *name, int (*entry) (u32_t arglen, void *argp), int priority, int stack, u32_t attr, int affinity, void *opt), (name, entry, priority, stack, attr, affinity, opt)) \
+    FUNC(int, sceKernelDeleteThread, (PsvUID thid), (thid)) \
+    FUNC(int, sceKernelWaitThreadEnd, (PsvUID thid, int *status, u32_t *timeout), (thid, status, timeout)) \
+    FUNC(u32_t, sceKernelGetSystemTimeLow, (void), ()) \
+    FUNC(int, sceDisplayGetFrameBuf, (PsvDisplayFrameBuf *frame, int sync), (frame, sync))
+
+#define STUB_DECLARE(type, name, params, args) STUB_FUNCTION(type, name, params);
+UVL_SCE_FUNCTIONS(STUB_DECLARE)
+
+/** \name Provided by the exploit
+ *  @{
+ */
+void psvUnlockMem (void);
+void psvLockMem (void);
+PsvUID sceKernelAllocCodeMemBlock (const char *name, u32_t size);
+/** @}*/
+
+#ifdef UVL_STATS
+/** \brief Statistics of one imported function
+ */
+typedef struct sce_stats
+{
+    u32_t   count;                          ///< Number of calls
+    u32_t   total;                          ///< Total time in microseconds
+    u32_t   max;                            ///< Longest call in microseconds
+    u32_t   buckets[UVL_STATS_BUCKETS];     ///< Calls by log2 of microseconds
+} sce_stats_t;
+
+#define STATS_INDEX(type, name, params, args) UVL_STATS_##name,
+enum { UVL_SCE_FUNCTIONS(STATS_INDEX) UVL_STATS_COUNT };
+
+#define STATS_DECLARE(type, name, params, args) type name params;
+UVL_SCE_FUNCTIONS(STATS_DECLARE)
+
+int uvl_stats_init ();
+void uvl_stats_dump (const char *when);
+#else
+#define uvl_stats_init()
+#define uvl_stats_dump(when)
+#endif
 
 void uvl_scefuncs_resolve_loader ();
+int uvl_scefuncs_resolve_display ();
 
 #endif
@@ -0,0 +1,459 @@
+/*
+ * snapshot.c - Per-boot table of syscall numbers
+ * Copyright 2012 Yifan Lu
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "snapshot.h"
+#include "config.h"
+#include "load.h"
+#include "resolve.h"
+#include "scefuncs.h"
+#include "utils.h"
+#ifdef USE_NEON
+#include <arm_neon.h>
+#endif
+
+/** One syscall found while scanning */
+typedef struct snapshot_pair
+{
+    u32_t   nid;            ///< NID imported
+    u32_t   syscall;        ///< Syscall number it was resolved to
+} snapshot_pair_t;
+
+/** Snapshot of this launch, in a block that is never freed */
+snapshot_t *g_snapshot = NULL;
+
+/********************************************//**
+ *  \brief Gets the syscall number of a stub
+ *  
+ *  The first two instructions are checked with
+ *  a mask and compare over the whole stub.
+ *  With @c USE_NEON the stub is one vector.
+ *  \returns Syscall number, or -1 if not a
+ *  resolved syscall stub
+ ***********************************************/
+static inline int
+uvl_snapshot_stub (const u32_t *stub)   ///< Stub function to read
+{
+#ifdef USE_NEON
+    static const u32_t mask[4] = {SNAPSHOT_STUB_MASK0, SNAPSHOT_STUB_MASK1, 0, 0};
+    static const u32_t match[4] = {SNAPSHOT_STUB_MATCH0, SNAPSHOT_STUB_MATCH1, 0, 0};
+    uint32x4_t inst = vld1q_u32 (stub);
+    uint32x4_t eq = vceqq_u32 (vandq_u32 (inst, vld1q_u32 (mask)), vld1q_u32 (match));
+    uint32x2_t all = vand_u32 (vget_low_u32 (eq), vget_high_u32 (eq));
+    if ((vget_lane_u32 (all, 0) & vget_lane_u32 (all, 1)) == 0)
+    {
+        return -1;
+    }
+#else
+    if ((stub[0] & SNAPSHOT_STUB_MASK0) != SNAPSHOT_STUB_MATCH0 || (stub[1] & SNAPSHOT_STUB_MASK1) != SNAPSHOT_STUB_MATCH1)
+    {
+        return -1;
+    }
+#endif
+    // MOVW immediate at 19-16 and 11-0
+    return ((stub[0] >> 4) & 0xF000) | (stub[0] & 0xFFF);
+}
+
+/********************************************//**
+ *  \brief Collects syscalls from the import
+ *  stubs of loaded modules
+ *  
+ *  Stops once @a max syscalls are found. The
+ *  same NID may be found more than once.
+ *  \returns Number of syscalls found
+ ***********************************************/
+static u32_t
+uvl_snapshot_scan (PsvUID *mod_list,            ///< Loaded modules
+                    u32_t num_loaded,           ///< Number of loaded modules
+          snapshot_pair_t *pairs,               ///< Where to write syscalls found
+                    u32_t max)                  ///< Maximum number of syscalls to find
+{
+    loaded_module_info_t m_mod_info;
+    module_info_t *mod_info;
+    module_ports_iter_t iter;
+    module_imports_t *imports;
+    u32_t base;
+    u32_t count;
+    u32_t i, j;
+    int syscall;
+
+    count = 0;
+    for (i = 0; i < num_loaded && count < max; i++)
+    {
+        m_mod_info.size = sizeof (loaded_module_info_t); // should be 440
+        if (sceKernelGetModuleInfo (mod_list[i], &m_mod_info) < 0 || uvl_resolve_find_module_info (&m_mod_info, &mod_info) < 0)
+        {
+            IF_DEBUG LOG ("Cannot read imports of mod 0x%08X, continuing", mod_list[i]);
+            continue;
+        }
+        base = (u32_t)m_mod_info.segments[0].vaddr;
+        uvl_module_ports_begin (&iter, (void*)(base + mod_info->stub_top), (void*)(base + mod_info->stub_end), MODULE_PORTS_IMPORTS, 0);
+        while (count < max && (imports = (module_imports_t*)uvl_module_ports_next (&iter)) != NULL)
+        {
+            for (j = 0; j < imports->num_functions && count < max; j++)
+            {
+                if ((syscall = uvl_snapshot_stub (imports->func_entry_table[j])) < 0)
+                {
+                    continue; // not a resolved syscall stub
+                }
+                pairs[count].nid = imports->func_nid_table[j];
+                pairs[count].syscall = syscall;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+/********************************************//**
+ *  \brief Computes the key of the loaded
+ *  modules
+ *  
+ *  A snapshot is only reused when the same
+ *  modules are loaded at the same addresses.
+ *  \returns CRC-32 of the modules' names and
+ *  bases
+ ***********************************************/
+static u32_t
+uvl_snapshot_key (PsvUID *mod_list,             ///< Loaded modules
+                   u32_t num_loaded)            ///< Number of loaded modules
+{
+    loaded_module_info_t m_mod_info;
+    u32_t crc;
+    u32_t i;
+
+    crc = 0;
+    for (i = 0; i < num_loaded; i++)
+    {
+        m_mod_info.size = sizeof (loaded_module_info_t); // should be 440
+        if (sceKernelGetModuleInfo (mod_list[i], &m_mod_info) < 0)
+        {
+            continue;
+        }
+        crc = crc32 (crc, m_mod_info.module_name, strlen (m_mod_info.module_name));
+        crc = crc32 (crc, &m_mod_info.segments[0].vaddr, sizeof (void*));
+    }
+    return crc;
+}
+
+/********************************************//**
+ *  \brief Sorts syscalls by NID
+ ***********************************************/
+static int
+uvl_snapshot_pair_compare (const void *a, const void *b)
+{
+    const snapshot_pair_t *x = a;
+    const snapshot_pair_t *y = b;
+
+    if (x->nid != y->nid)
+    {
+        return x->nid < y->nid ? -1 : 1;
+    }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Builds a snapshot from the import
+ *  stubs of every loaded module
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+static int
+uvl_snapshot_build (snapshot_t *snapshot,       ///< Where to build the snapshot
+                        PsvUID *mod_list,       ///< Loaded modules
+                         u32_t num_loaded,      ///< Number of loaded modules
+                         u32_t key)             ///< Key of the loaded modules
+{
+    snapshot_pair_t *pairs;
+    PsvUID block;
+    u32_t *nids;
+    u16_t *syscalls;
+    u32_t count;
+    u32_t i, j;
+
+    block = sceKernelAllocMemBlock ("UVLSnapshotScan", 0xC20D060, (MAX_SNAPSHOT_STUBS * sizeof (snapshot_pair_t) + 0xFFF) & ~0xFFF, NULL);
+    if (block < 0)
+    {
+        LOG ("Cannot allocate memory to scan syscalls.");
+        return -1;
+    }
+    if (sceKernelGetMemBlockBase (block, (void**)&pairs) < 0)
+    {
+        LOG ("Cannot get memory to scan syscalls.");
+        sceKernelFreeMemBlock (block);
+        return -1;
+    }
+    count = uvl_snapshot_scan (mod_list, num_loaded, pairs, MAX_SNAPSHOT_STUBS);
+    qsort (pairs, count, sizeof (snapshot_pair_t), uvl_snapshot_pair_compare);
+    // keep one entry for NIDs imported by more than one module
+    for (i = 0, j = 0; i < count; i++)
+    {
+        if (j == 0 || pairs[i].nid != pairs[j - 1].nid)
+        {
+            pairs[j++] = pairs[i];
+        }
+    }
+    if (count == MAX_SNAPSHOT_STUBS || j > MAX_SNAPSHOT_SYSCALLS)
+    {
+        LOG ("Syscall snapshot full, some syscalls are missing. Please recompile with a larger snapshot.");
+        j = j > MAX_SNAPSHOT_SYSCALLS ? MAX_SNAPSHOT_SYSCALLS : j;
+    }
+    snapshot->magic = SNAPSHOT_MAGIC;
+    snapshot->key = key;
+    snapshot->count = j;
+    snapshot->size = sizeof (snapshot_t) + j * (sizeof (u32_t) + sizeof (u16_t));
+    nids = SNAPSHOT_NIDS (snapshot);
+    syscalls = SNAPSHOT_SYSCALLS (snapshot);
+    for (i = 0; i < j; i++)
+    {
+        nids[i] = pairs[i].nid;
+        syscalls[i] = pairs[i].syscall;
+    }
+    sceKernelFreeMemBlock (block);
+    IF_DEBUG LOG ("Found %u syscalls in %u stubs.", j, count);
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Reads a snapshot saved by an earlier
+ *  launch
+ *  
+ *  The snapshot must be for the same loaded
+ *  modules, and a few stubs are decoded to
+ *  check that it is from this boot. With no 
+ *  stubs to decode, it cannot be checked and 
+ *  is not used.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+static int
+uvl_snapshot_read (const char *path,            ///< Saved snapshot
+               snapshot_t *snapshot,            ///< Where to read the snapshot to
+                   PsvUID *mod_list,            ///< Loaded modules
+                    u32_t num_loaded,           ///< Number of loaded modules
+                    u32_t key)                  ///< Key of the loaded modules
+{
+    snapshot_pair_t checks[SNAPSHOT_CHECKS];
+    PsvUID fd;
+    PsvSSize size;
+    u32_t count;
+    u32_t i;
+
+    fd = sceIoOpen (path, PSP2_O_RDONLY, 0);
+    if (fd < 0)
+    {
+        IF_DEBUG LOG ("No syscall snapshot at %s", path);
+        return -1;
+    }
+    size = sceIoRead (fd, snapshot, SNAPSHOT_BLOCK_SIZE);
+    sceIoClose (fd);
+    if (size < (PsvSSize)sizeof (snapshot_t) || snapshot->magic != SNAPSHOT_MAGIC ||
+        snapshot->count > MAX_SNAPSHOT_SYSCALLS || snapshot->size != sizeof (snapshot_t) + snapshot->count * (sizeof (u32_t) + sizeof (u16_t)) ||
+        snapshot->size > size)
+    {
+        LOG ("Syscall snapshot %s is invalid.", path);
+        return -1;
+    }
+    if (snapshot->key != key)
+    {
+        IF_DEBUG LOG ("Syscall snapshot is for other modules.");
+        return -1;
+    }
+    count = uvl_snapshot_scan (mod_list, num_loaded, checks, SNAPSHOT_CHECKS);
+    if (count == 0)
+    {
+        IF_DEBUG LOG ("No syscall stubs to check the snapshot against.");
+        return -1;
+    }
+    for (i = 0; i < count; i++)
+    {
+        if (uvl_snapshot_find (snapshot, checks[i].nid) != (int)checks[i].syscall)
+        {
+            IF_DEBUG LOG ("Syscall snapshot is from another boot.");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Creates the directory a snapshot is 
+ *  saved in
+ *  
+ *  Only the last directory in @a path is 
+ *  created. Errors are ignored, it usually 
+ *  exists already.
+ ***********************************************/
+static void
+uvl_snapshot_mkdir (const char *path)           ///< Path of the snapshot file
+{
+    char dir[MAX_PATH_LENGTH];
+    u32_t length;
+
+    length = strlen (path);
+    if (length >= MAX_PATH_LENGTH)
+    {
+        return;
+    }
+    while (length > 0 && path[length - 1] != '/')
+    {
+        length--;
+    }
+    if (length <= 1 || path[length - 2] == ':')
+    {
+        return; // file is in the root
+    }
+    memcpy (dir, path, length - 1);
+    dir[length - 1] = '\0';
+    sceIoMkdir (dir, PSP2_STM_RWXU);
+}
+
+/********************************************//**
+ *  \brief Gets the syscall snapshot for this
+ *  boot
+ *  
+ *  A snapshot saved by an earlier launch in
+ *  the same boot is reused. Otherwise every
+ *  loaded module's import stubs are decoded in
+ *  one pass and the result is saved to
+ *  @c UVL_SNAPSHOT_PATH for the next launch.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_snapshot_get (PsvUID *mod_list,             ///< Loaded modules
+                   u32_t num_loaded,            ///< Number of loaded modules
+             snapshot_t **snapshot)             ///< Returned snapshot
+{
+    snapshot_t *resident;
+    PsvUID block;
+    PsvUID fd;
+    u32_t key;
+    u32_t start;
+
+    if (g_snapshot != NULL)
+    {
+        *snapshot = g_snapshot;
+        return 0;
+    }
+    block = sceKernelAllocMemBlock ("UVLSnapshot", 0xC20D060, SNAPSHOT_BLOCK_SIZE, NULL);
+    if (block < 0)
+    {
+        LOG ("Cannot allocate syscall snapshot.");
+        return -1;
+    }
+    if (sceKernelGetMemBlockBase (block, (void**)&resident) < 0)
+    {
+        LOG ("Cannot get syscall snapshot address.");
+        sceKernelFreeMemBlock (block);
+        return -1;
+    }
+    start = sceKernelGetSystemTimeLow ();
+    key = uvl_snapshot_key (mod_list, num_loaded);
+    if (UVL_SNAPSHOT_PATH[0] != '\0' && uvl_snapshot_read (UVL_SNAPSHOT_PATH, resident, mod_list, num_loaded, key) == 0)
+    {
+        IF_DEBUG LOG ("Reused snapshot of %u syscalls in %u us.", resident->count, sceKernelGetSystemTimeLow () - start);
+    }
+    else
+    {
+        if (uvl_snapshot_build (resident, mod_list, num_loaded, key) < 0)
+        {
+            sceKernelFreeMemBlock (block);
+            return -1;
+        }
+        IF_DEBUG LOG ("Built snapshot of %u syscalls in %u us.", resident->count, sceKernelGetSystemTimeLow () - start);
+        if (UVL_SNAPSHOT_PATH[0] != '\0')
+        {
+            uvl_snapshot_mkdir (UVL_SNAPSHOT_PATH);
+            fd = sceIoOpen (UVL_SNAPSHOT_PATH, PSP2_O_WRONLY | PSP2_O_CREAT | PSP2_O_TRUNC, PSP2_STM_RWU);
+            if (fd < 0 || sceIoWrite (fd, resident, resident->size) < 0)
+            {
+                LOG ("Cannot save syscall snapshot to %s. Continuing.", UVL_SNAPSHOT_PATH);
+            }
+            if (fd >= 0)
+            {
+                sceIoClose (fd);
+            }
+        }
+    }
+    psvUnlockMem ();
+    g_snapshot = resident;
+    psvLockMem ();
+    *snapshot = resident;
+    return 0;
+}
+
+/********************************************//**
+ *  \brief Finds the syscall number of a NID
+ *  
+ *  \returns Syscall number, or -1 if not in
+ *  the snapshot
+ ***********************************************/
+int
+uvl_snapshot_find (snapshot_t *snapshot,        ///< Snapshot to search
+                        u32_t nid)              ///< NID to find
+{
+    u32_t *nids;
+    u32_t low, high, mid;
+
+    nids = SNAPSHOT_NIDS (snapshot);
+    low = 0;
+    high = snapshot->count;
+    while (low < high)
+    {
+        mid = (low + high) >> 1;
+        if (nids[mid] < nid)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    if (low < snapshot->count && nids[low] == nid)
+    {
+        return SNAPSHOT_SYSCALLS (snapshot)[low];
+    }
+    return -1;
+}
+
+/********************************************//**
+ *  \brief Adds every syscall of a snapshot to
+ *  the resolve table
+ *  
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+int
+uvl_snapshot_add_all (snapshot_t *snapshot)     ///< Snapshot to add
+{
+    resolve_entry_t res_entry;
+    u32_t *nids;
+    u16_t *syscalls;
+    u32_t i;
+
+    nids = SNAPSHOT_NIDS (snapshot);
+    syscalls = SNAPSHOT_SYSCALLS (snapshot);
+    res_entry.type = RESOLVE_TYPE_SYSCALL;
+    for (i = 0; i < snapshot->count; i++)
+    {
+        res_entry.nid = nids[i];
+        res_entry.value.syscall = syscalls[i];
+        if (uvl_resolve_table_add (&res_entry) < 0)
+        {
+            LOG ("Error adding entry to table.");
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+/// 
+/// \file snapshot.h
+/// \brief Per-boot table of syscall numbers
+/// \defgroup snapshot Syscall Snapshot
+/// \brief Keeps the syscalls of loaded modules for later launches
+/// @{
+/// 
+#ifndef UVL_SNAPSHOT
+#define UVL_SNAPSHOT
+
+#include "types.h"
+
+#define SNAPSHOT_MAGIC          0x53535655  ///< "UVSS"
+#define SNAPSHOT_BLOCK_SIZE     0x10000     ///< Size of the resident block holding the snapshot
+#define MAX_SNAPSHOT_SYSCALLS   0x2000      ///< Maximum number of syscalls, must fit in the block
+#define MAX_SNAPSHOT_STUBS      0x8000      ///< Maximum number of syscall stubs decoded, counting NIDs imported more than once
+#define SNAPSHOT_CHECKS         8           ///< Stubs decoded to check that a saved snapshot is from this boot
+
+/** \name Syscall stub pattern
+ *  A resolved syscall stub starts with
+ *  MOVW R12, \#syscall then SVC \#0.
+ *  @{
+ */
+#define SNAPSHOT_STUB_MASK0     0xFFF0F000  ///< MOVW R12 without the immediate
+#define SNAPSHOT_STUB_MATCH0    0xE300C000  ///< MOVW R12, \#0
+#define SNAPSHOT_STUB_MASK1     0xFF000000  ///< SVC without the immediate
+#define SNAPSHOT_STUB_MATCH1    0xEF000000  ///< SVC \#0
+/** @}*/
+
+/**
+ * \brief Syscall snapshot header
+ * 
+ * Followed by @c count sorted NIDs, then
+ * @c count parallel syscall numbers.
+ */
+typedef struct snapshot
+{
+    u32_t   magic;          ///< @c SNAPSHOT_MAGIC
+    u32_t   key;            ///< CRC-32 of the loaded modules' names and bases
+    u32_t   count;          ///< Number of syscalls
+    u32_t   size;           ///< Bytes used including this header
+} snapshot_t;
+
+/** Sorted NIDs of a snapshot */
+#define SNAPSHOT_NIDS(snapshot) ((u32_t*)&(snapshot)[1])
+/** Syscall numbers parallel to @c SNAPSHOT_NIDS */
+#define SNAPSHOT_SYSCALLS(snapshot) ((u16_t*)&SNAPSHOT_NIDS (snapshot)[(snapshot)->count])
+
+int uvl_snapshot_get (PsvUID *mod_list, u32_t num_loaded, snapshot_t **snapshot);
+int uvl_snapshot_find (snapshot_t *snapshot, u32_t nid);
+int uvl_snapshot_add_all (snapshot_t *snapshot);
+
+#endif
+/// @}
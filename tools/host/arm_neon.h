@@ -0,0 +1,129 @@
+/*
+ * arm_neon.h - Host stand-in for the NEON intrinsics the loader uses
+ * Copyright 2012 Yifan Lu
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Found before the compiler's own header when a host mock is built with
+// -Itools/host, so code under USE_NEON runs on the host. Each intrinsic
+// is done one lane at a time with the result the ARM instruction gives.
+// Only the intrinsics used in the loader are here.
+#ifndef UVL_HOST_ARM_NEON
+#define UVL_HOST_ARM_NEON
+
+typedef struct { unsigned int val[4]; } uint32x4_t;
+typedef struct { unsigned int val[2]; } uint32x2_t;
+
+static inline uint32x4_t
+vld1q_u32 (const unsigned int *ptr)
+{
+    uint32x4_t r;
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        r.val[i] = ptr[i];
+    }
+    return r;
+}
+
+static inline uint32x4_t
+vdupq_n_u32 (unsigned int value)
+{
+    uint32x4_t r;
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        r.val[i] = value;
+    }
+    return r;
+}
+
+static inline uint32x4_t
+vorrq_u32 (uint32x4_t a, uint32x4_t b)
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        a.val[i] |= b.val[i];
+    }
+    return a;
+}
+
+static inline uint32x4_t
+vandq_u32 (uint32x4_t a, uint32x4_t b)
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        a.val[i] &= b.val[i];
+    }
+    return a;
+}
+
+/** Each lane is all ones if equal, otherwise zero */
+static inline uint32x4_t
+vceqq_u32 (uint32x4_t a, uint32x4_t b)
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        a.val[i] = a.val[i] == b.val[i] ? 0xFFFFFFFF : 0;
+    }
+    return a;
+}
+
+static inline uint32x2_t
+vorr_u32 (uint32x2_t a, uint32x2_t b)
+{
+    a.val[0] |= b.val[0];
+    a.val[1] |= b.val[1];
+    return a;
+}
+
+static inline uint32x2_t
+vand_u32 (uint32x2_t a, uint32x2_t b)
+{
+    a.val[0] &= b.val[0];
+    a.val[1] &= b.val[1];
+    return a;
+}
+
+static inline uint32x2_t
+vget_low_u32 (uint32x4_t a)
+{
+    uint32x2_t r;
+
+    r.val[0] = a.val[0];
+    r.val[1] = a.val[1];
+    return r;
+}
+
+static inline uint32x2_t
+vget_high_u32 (uint32x4_t a)
+{
+    uint32x2_t r;
+
+    r.val[0] = a.val[2];
+    r.val[1] = a.val[3];
+    return r;
+}
+
+// the lane is a constant on ARM, any index works here
+#define vget_lane_u32(a, lane)  ((a).val[(lane)])
+
+#endif
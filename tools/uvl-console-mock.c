@@ -0,0 +1,178 @@
+/*
+ * uvl-console-mock.c - Draws the debug console into a mock framebuffer
+ * Copyright 2012 Yifan Lu
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host tool, built with the host compiler. console.c is compiled in and
+// draws into a framebuffer of a few rows, with pixels past each line and
+// below the last row to catch stray writes. After each flush the whole
+// buffer is compared with a golden image drawn from the text the screen
+// should show, and the mock fails on any difference. A row that should
+// not be redrawn is overwritten before the flush, so a redraw is seen.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// console.c needs nothing from the target but its types
+#define UVL_UTILS
+#undef NULL
+#include "../types.h"
+
+#include "../console.c"
+
+#define MOCK_COLS           4
+#define MOCK_ROWS           3
+#define MOCK_WIDTH          (MOCK_COLS * CONSOLE_GLYPH_SIZE)
+#define MOCK_HEIGHT         (MOCK_ROWS * CONSOLE_GLYPH_SIZE)
+#define MOCK_PITCH          (MOCK_WIDTH + 4)            // pixels past each line
+#define MOCK_LINES          (MOCK_HEIGHT + 2)           // lines below the last row
+#define MOCK_FG             0xFFFFFFFF
+#define MOCK_BG             0xFF000000
+#define MOCK_FILL           0x5A5A5A5A                  // what the framebuffer holds before drawing
+
+static console_t g_console;
+static u32_t g_frame[MOCK_LINES][MOCK_PITCH];
+static u32_t g_golden[MOCK_LINES][MOCK_PITCH];
+static int g_errors;
+
+/** Fills @a frame with @c MOCK_FILL */
+static void
+mock_fill (u32_t frame[MOCK_LINES][MOCK_PITCH])
+{
+    u32_t y, x;
+
+    for (y = 0; y < MOCK_LINES; y++)
+    {
+        for (x = 0; x < MOCK_PITCH; x++)
+        {
+            frame[y][x] = MOCK_FILL;
+        }
+    }
+}
+
+/** Draws the golden image of a screen showing @a screen, one string per row */
+static void
+mock_golden (const char *screen[MOCK_ROWS])
+{
+    u32_t row, col, y, x;
+    u8_t c;
+
+    mock_fill (g_golden);
+    for (row = 0; row < MOCK_ROWS; row++)
+    {
+        for (col = 0; col < MOCK_COLS; col++)
+        {
+            c = (u8_t)screen[row][col] - CONSOLE_FIRST_CHAR;
+            for (y = 0; y < CONSOLE_GLYPH_SIZE; y++)
+            {
+                for (x = 0; x < CONSOLE_GLYPH_SIZE; x++)
+                {
+                    g_golden[row * CONSOLE_GLYPH_SIZE + y][col * CONSOLE_GLYPH_SIZE + x] = (g_console_font[c][y] >> x) & 1 ? MOCK_FG : MOCK_BG;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Prints @a str, flushes and checks the framebuffer shows @a screen and
+ * that @a expected rows were drawn. Screen row @a kept is overwritten
+ * before the flush and must not be drawn, -1 for none.
+ */
+static void
+mock_step (const char *name, const char *str, const char *screen[MOCK_ROWS], int expected, int kept)
+{
+    u32_t y, x;
+    int drawn;
+
+    uvl_console_print (&g_console, str);
+    if (kept >= 0)
+    {
+        for (y = kept * CONSOLE_GLYPH_SIZE; y < (kept + 1) * CONSOLE_GLYPH_SIZE; y++)
+        {
+            for (x = 0; x < MOCK_WIDTH; x++)
+            {
+                g_frame[y][x] = MOCK_FILL;
+            }
+        }
+    }
+    drawn = uvl_console_flush (&g_console, 0, 1);
+    mock_golden (screen);
+    if (kept >= 0)
+    {
+        for (y = kept * CONSOLE_GLYPH_SIZE; y < (kept + 1) * CONSOLE_GLYPH_SIZE; y++)
+        {
+            for (x = 0; x < MOCK_WIDTH; x++)
+            {
+                g_golden[y][x] = MOCK_FILL;
+            }
+        }
+    }
+    if (drawn != expected)
+    {
+        printf ("%s: %d rows drawn, expected %d.\n", name, drawn, expected);
+        g_errors++;
+    }
+    for (y = 0; y < MOCK_LINES; y++)
+    {
+        for (x = 0; x < MOCK_PITCH; x++)
+        {
+            if (g_frame[y][x] != g_golden[y][x])
+            {
+                printf ("%s: pixel %u,%u is 0x%08X, expected 0x%08X.\n", name, x, y, g_frame[y][x], g_golden[y][x]);
+                g_errors++;
+                return;
+            }
+        }
+    }
+    printf ("%s: %d rows drawn\n", name, drawn);
+}
+
+int
+main (int argc, char *argv[])
+{
+    static const char *blank[] = {"    ", "    ", "    "};
+    static const char *two[] = {"ab  ", "cd  ", "    "};
+    static const char *wrapped[] = {"gh  ", "cd  ", "ef  "};
+    static const char *long_line[] = {"ghij", "klmn", "ef  "};
+
+    mock_fill (g_frame);
+    if (uvl_console_init (&g_console, &g_frame[0][0], MOCK_WIDTH, MOCK_HEIGHT, MOCK_PITCH, MOCK_FG, MOCK_BG) < 0)
+    {
+        printf ("Console not set up.\n");
+        return 1;
+    }
+    if (g_console.cols != MOCK_COLS || g_console.rows != MOCK_ROWS)
+    {
+        printf ("Console is %ux%u, expected %ux%u.\n", g_console.cols, g_console.rows, MOCK_COLS, MOCK_ROWS);
+        return 1;
+    }
+    mock_step ("clear", "", blank, MOCK_ROWS, -1);
+    mock_step ("two lines", "ab\ncd", two, 2, -1);
+    if (uvl_console_flush (&g_console, CONSOLE_FLUSH_INTERVAL - 1, 0) != 0)
+    {
+        printf ("Flushed within a frame.\n");
+        g_errors++;
+    }
+    // the oldest line is replaced and the row in between is left alone
+    mock_step ("wrapped", "\nef\ngh", wrapped, 2, 1);
+    // the line goes past the last column and replaces the next oldest
+    mock_step ("long line", "ijklmn", long_line, 2, 2);
+    if (g_errors > 0)
+    {
+        printf ("%d errors.\n", g_errors);
+        return 1;
+    }
+    return 0;
+}
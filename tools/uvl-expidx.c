@@ -0,0 +1,336 @@
+/*
+ * uvl-expidx.c - Adds a hashed export index to a linked homebrew
+ * Copyright 2012 Yifan Lu
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host tool, built with the host compiler. Layouts are spelled out with
+// fixed width types since the UVL headers assume a 32-bit target. The
+// index format must match "Hashed export index" in load.h.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEC_MODINFO         ".sceModuleInfo.rodata"
+#define SEC_EXPIDX          ".uvl.expidx"
+#define EXPIDX_MAGIC        0x49585655
+#define EXPORT_TABLE_SIZE   0x20
+#define MODINFO_SIZE        0x5C        // sizeof (module_info_t)
+
+typedef struct
+{
+    uint32_t nid;
+    uint16_t table;
+    uint16_t index;
+} entry_t;
+
+static uint8_t *g_data;
+static uint32_t g_size;
+
+/** Reads a little endian 16-bit value */
+static uint32_t
+rd16 (uint32_t off)
+{
+    if (off + 2 > g_size)
+    {
+        fprintf (stderr, "Offset 0x%X out of file.\n", off);
+        exit (1);
+    }
+    return g_data[off] | (g_data[off + 1] << 8);
+}
+
+/** Reads a little endian 32-bit value */
+static uint32_t
+rd32 (uint32_t off)
+{
+    return rd16 (off) | (rd16 (off + 2) << 16);
+}
+
+/** Writes a little endian 32-bit value */
+static void
+wr32 (uint8_t *p, uint32_t val)
+{
+    p[0] = val;
+    p[1] = val >> 8;
+    p[2] = val >> 16;
+    p[3] = val >> 24;
+}
+
+/** Converts a virtual address to a file offset using the program headers */
+static uint32_t
+vaddr_to_offset (uint32_t vaddr)
+{
+    uint32_t phoff = rd32 (0x1C);
+    uint32_t phnum = rd16 (0x2C);
+    uint32_t i, ph;
+
+    for (i = 0; i < phnum; i++)
+    {
+        ph = phoff + i * 0x20;
+        if (rd32 (ph) == 1 && vaddr >= rd32 (ph + 0x08) && vaddr < rd32 (ph + 0x08) + rd32 (ph + 0x10))
+        {
+            return rd32 (ph + 0x04) + vaddr - rd32 (ph + 0x08);
+        }
+    }
+    fprintf (stderr, "Address 0x%08X is not in a segment.\n", vaddr);
+    exit (1);
+}
+
+/** Finds a section header by name, returns its offset or 0 */
+static uint32_t
+find_section (const char *name)
+{
+    uint32_t shoff = rd32 (0x20);
+    uint32_t shnum = rd16 (0x30);
+    uint32_t strtab = shoff + rd16 (0x32) * 0x28;
+    uint32_t i, sh, str;
+
+    for (i = 0; i < shnum; i++)
+    {
+        sh = shoff + i * 0x28;
+        str = rd32 (strtab + 0x10) + rd32 (sh);
+        if (str + strlen (name) < g_size && memcmp (&g_data[str], name, strlen (name) + 1) == 0)
+        {
+            return sh;
+        }
+    }
+    return 0;
+}
+
+/** Gets the size of an export table, stopping where the loader's walk stops */
+static uint32_t
+table_size (uint32_t table, uint32_t end)
+{
+    uint32_t size;
+
+    if (table + EXPORT_TABLE_SIZE > end)
+    {
+        return 0;
+    }
+    size = rd16 (table);
+    if (size < EXPORT_TABLE_SIZE || (size & 3) != 0 || table + size > end)
+    {
+        fprintf (stderr, "Export table at 0x%X has a bad size 0x%X.\n", table, size);
+        exit (1);
+    }
+    return size;
+}
+
+/** Orders entries by bucket, keeping table order within a bucket */
+static uint32_t g_mask;
+static int
+compare_bucket (const void *a, const void *b)
+{
+    const entry_t *x = a;
+    const entry_t *y = b;
+
+    if ((x->nid & g_mask) != (y->nid & g_mask))
+    {
+        return (x->nid & g_mask) < (y->nid & g_mask) ? -1 : 1;
+    }
+    if (x->table != y->table)
+    {
+        return x->table < y->table ? -1 : 1;
+    }
+    return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+/** Rounds up to a power of two */
+static uint32_t
+pow2 (uint32_t n)
+{
+    uint32_t p = 1;
+    while (p < n)
+    {
+        p <<= 1;
+    }
+    return p;
+}
+
+int
+main (int argc, char *argv[])
+{
+    FILE *fp;
+    uint32_t ph0, modinfo, ent_top, ent_end, base, table, size, nids, count, i, j;
+    uint32_t num_entries, num_buckets, bloom_words, blob_size;
+    uint32_t shoff, shnum, shstrndx, strtab_sh, strtab_size, name_off;
+    uint32_t blob_off, strtab_off, new_shoff, out_size;
+    entry_t *entries;
+    uint8_t *out, *blob;
+    uint32_t *bloom, *buckets;
+
+    if (argc < 2)
+    {
+        fprintf (stderr, "usage: %s homebrew.elf [output.elf]\n", argv[0]);
+        return 1;
+    }
+    if ((fp = fopen (argv[1], "rb")) == NULL)
+    {
+        perror (argv[1]);
+        return 1;
+    }
+    fseek (fp, 0, SEEK_END);
+    g_size = ftell (fp);
+    fseek (fp, 0, SEEK_SET);
+    g_data = malloc (g_size);
+    if (fread (g_data, 1, g_size, fp) != g_size)
+    {
+        perror ("read");
+        return 1;
+    }
+    fclose (fp);
+
+    if (g_size < 0x34 || memcmp (g_data, "\x7F" "ELF\x01\x01", 6) != 0 || rd16 (0x12) != 40)
+    {
+        fprintf (stderr, "Not a 32-bit little endian ARM ELF.\n");
+        return 1;
+    }
+    shoff = rd32 (0x20);
+    shnum = rd16 (0x30);
+    shstrndx = rd16 (0x32);
+    if (shoff == 0 || shstrndx == 0)
+    {
+        fprintf (stderr, "Section headers are needed to add the index.\n");
+        return 1;
+    }
+    if (find_section (SEC_EXPIDX) != 0)
+    {
+        fprintf (stderr, "Already has %s.\n", SEC_EXPIDX);
+        return 1;
+    }
+
+    // module info, same lookup order as the loader
+    ph0 = rd32 (0x1C);
+    modinfo = rd32 (ph0 + 0x0C) & 0x3FFFFFFF;
+    if (modinfo != 0 && modinfo + MODINFO_SIZE <= rd32 (ph0 + 0x10))
+    {
+        modinfo += rd32 (ph0 + 0x04);
+    }
+    else if ((modinfo = find_section (SEC_MODINFO)) != 0)
+    {
+        modinfo = rd32 (modinfo + 0x10);
+    }
+    else
+    {
+        fprintf (stderr, "Cannot find module info.\n");
+        return 1;
+    }
+    ent_top = rd32 (modinfo + 0x24);
+    ent_end = rd32 (modinfo + 0x28);
+    if (ent_end - ent_top > 0xFFFF)
+    {
+        fprintf (stderr, "Export tables too large.\n");
+        return 1;
+    }
+
+    // collect exports
+    num_entries = 0;
+    base = rd32 (ph0 + 0x04);
+    for (table = ent_top; (size = table_size (base + table, base + ent_end)) != 0; table += size)
+    {
+        num_entries += rd16 (base + table + 0x06) + rd32 (base + table + 0x08);
+    }
+    entries = calloc (num_entries ? num_entries : 1, sizeof (entry_t));
+    num_entries = 0;
+    for (table = ent_top; (size = table_size (base + table, base + ent_end)) != 0; table += size)
+    {
+        j = base + table;
+        count = rd16 (j + 0x06) + rd32 (j + 0x08);
+        if (count == 0)
+        {
+            continue;
+        }
+        nids = vaddr_to_offset (rd32 (j + 0x18));
+        for (i = 0; i < count; i++)
+        {
+            entries[num_entries].nid = rd32 (nids + i * 4);
+            entries[num_entries].table = table - ent_top;
+            entries[num_entries].index = i;
+            num_entries++;
+        }
+    }
+
+    // build index
+    num_buckets = pow2 (num_entries);
+    bloom_words = pow2 ((num_entries + 3) / 4);
+    g_mask = num_buckets - 1;
+    qsort (entries, num_entries, sizeof (entry_t), compare_bucket);
+    blob_size = 16 + (bloom_words + num_buckets) * 4 + num_entries * 8;
+    blob = calloc (1, blob_size);
+    bloom = calloc (bloom_words, 4);
+    buckets = malloc (num_buckets * 4);
+    for (i = 0; i < num_buckets; i++)
+    {
+        buckets[i] = num_entries; // empty
+    }
+    for (i = num_entries; i-- > 0;)
+    {
+        uint32_t nid = entries[i].nid;
+        buckets[nid & g_mask] = i;
+        bloom[(nid >> 5) & (bloom_words - 1)] |= (1u << (nid & 31)) | (1u << ((nid >> 26) & 31));
+    }
+    wr32 (&blob[0], EXPIDX_MAGIC);
+    wr32 (&blob[4], num_buckets);
+    wr32 (&blob[8], bloom_words);
+    wr32 (&blob[12], num_entries);
+    j = 16;
+    for (i = 0; i < bloom_words; i++, j += 4)
+    {
+        wr32 (&blob[j], bloom[i]);
+    }
+    for (i = 0; i < num_buckets; i++, j += 4)
+    {
+        wr32 (&blob[j], buckets[i]);
+    }
+    for (i = 0; i < num_entries; i++, j += 8)
+    {
+        wr32 (&blob[j], entries[i].nid);
+        wr32 (&blob[j + 4], entries[i].table | (entries[i].index << 16));
+    }
+
+    // append index, grown string table, and section headers
+    strtab_sh = shoff + shstrndx * 0x28;
+    strtab_size = rd32 (strtab_sh + 0x14);
+    blob_off = (g_size + 3) & ~3;
+    strtab_off = blob_off + blob_size;
+    name_off = strtab_size;
+    new_shoff = (strtab_off + strtab_size + sizeof (SEC_EXPIDX) + 3) & ~3;
+    out_size = new_shoff + (shnum + 1) * 0x28;
+    out = calloc (1, out_size);
+    memcpy (out, g_data, g_size);
+    memcpy (&out[blob_off], blob, blob_size);
+    memcpy (&out[strtab_off], &g_data[rd32 (strtab_sh + 0x10)], strtab_size);
+    memcpy (&out[strtab_off + strtab_size], SEC_EXPIDX, sizeof (SEC_EXPIDX));
+    memcpy (&out[new_shoff], &g_data[shoff], shnum * 0x28);
+    wr32 (&out[new_shoff + shstrndx * 0x28 + 0x10], strtab_off);
+    wr32 (&out[new_shoff + shstrndx * 0x28 + 0x14], strtab_size + sizeof (SEC_EXPIDX));
+    j = new_shoff + shnum * 0x28;
+    wr32 (&out[j + 0x00], name_off);
+    wr32 (&out[j + 0x04], 1);           // SHT_PROGBITS
+    wr32 (&out[j + 0x10], blob_off);
+    wr32 (&out[j + 0x14], blob_size);
+    wr32 (&out[j + 0x20], 4);           // sh_addralign
+    wr32 (&out[0x20], new_shoff);
+    out[0x30] = (shnum + 1) & 0xFF;
+    out[0x31] = (shnum + 1) >> 8;
+
+    if ((fp = fopen (argc > 2 ? argv[2] : argv[1], "wb")) == NULL || fwrite (out, 1, out_size, fp) != out_size)
+    {
+        perror ("write");
+        return 1;
+    }
+    fclose (fp);
+    printf ("Indexed %u exports in %u buckets.\n", num_entries, num_buckets);
+    return 0;
+}
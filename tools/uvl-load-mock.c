@@ -0,0 +1,147 @@
+/*
+ * uvl-load-mock.c - Runs the parallel segment loader against mock segments
+ * Copyright 2012 Yifan Lu
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host tool, built with the host compiler. load.c is compiled in with the
+// imports from uvl-mock.c. Segments of uneven sizes, including empty ones,
+// are split into chunks and loaded on one and on several threads. The
+// mock fails if any byte is not copied or zeroed, or if a byte past the
+// end of a segment is written.
+#include "uvl-mock.h"
+
+#define MOCK_GUARD          0x1000  // bytes checked after each segment
+#define MOCK_FILL           0xA5    // what the loaded memory holds before loading
+
+typedef struct
+{
+    u32_t           copy;
+    u32_t           zero;
+} mock_segment_t;
+
+#include "../load.c"
+
+static int g_errors;
+
+// only reached when loading a real module, which the mock does not do
+u32_t uvl_resolve_table_pin (loaded_module_info_t *m_mod_info) { return 0; }
+int uvl_resolve_table_add (resolve_entry_t *entry) { return -1; }
+int uvl_resolve_add_exports (module_exports_t *exp_table) { return -1; }
+int uvl_resolve_imports (module_imports_t *import) { return -1; }
+void uvl_resolve_trap_report () {}
+void uvl_module_ports_begin (module_ports_iter_t *iter, void *start, void *end, int kind, u32_t delta) {}
+module_ports_t *uvl_module_ports_next (module_ports_iter_t *iter) { return NULL; }
+
+/**
+ * Loads @a count segments with @a threads threads and checks every byte.
+ * Each segment gets its own buffer with a guard after it, and file data
+ * that differs for every segment.
+ */
+static int
+mock_run (const char *name, const mock_segment_t *segments, u32_t count, u32_t threads)
+{
+    load_work_t work;
+    u8_t *dst[UVL_LOAD_MAX_SEGMENTS];
+    u8_t *src[UVL_LOAD_MAX_SEGMENTS];
+    u32_t errors;
+    u32_t size;
+    u32_t i, j;
+
+    memset (&work, 0, sizeof (work));
+    mock_threads_max ();
+    for (i = 0; i < count; i++)
+    {
+        size = segments[i].copy + segments[i].zero;
+        dst[i] = malloc (size + MOCK_GUARD);
+        src[i] = malloc (segments[i].copy + 1);
+        memset (dst[i], MOCK_FILL, size + MOCK_GUARD);
+        for (j = 0; j < segments[i].copy; j++)
+        {
+            src[i][j] = (u8_t)(j * 7 + i + 1) | 1; // never zero or the fill
+        }
+        if (uvl_load_work_add (&work, dst[i], src[i], segments[i].copy, segments[i].zero) < 0)
+        {
+            printf ("%s: segment %u not added.\n", name, i);
+            g_errors++;
+            return -1;
+        }
+    }
+    if (count == UVL_LOAD_MAX_SEGMENTS && uvl_load_work_add (&work, dst[0], src[0], 0, 0) == 0)
+    {
+        printf ("%s: more than %u segments added.\n", name, UVL_LOAD_MAX_SEGMENTS);
+        g_errors++;
+    }
+    uvl_load_work_run (&work, threads);
+    errors = 0;
+    for (i = 0; i < count; i++)
+    {
+        size = segments[i].copy + segments[i].zero;
+        for (j = 0; j < size + MOCK_GUARD; j++)
+        {
+            if (dst[i][j] != (j < segments[i].copy ? src[i][j] : j < size ? 0 : MOCK_FILL))
+            {
+                if (errors++ == 0)
+                {
+                    printf ("%s: segment %u byte 0x%X is 0x%02X.\n", name, i, j, dst[i][j]);
+                }
+            }
+        }
+        free (dst[i]);
+        free (src[i]);
+    }
+    if (work.next < work.num_chunks)
+    {
+        printf ("%s: only %u of %u chunks taken.\n", name, work.next, work.num_chunks);
+        errors++;
+    }
+    printf ("%s: %u segments, %u bytes in %u chunks, %u threads, %u wrong bytes\n", name, count, work.bytes, work.num_chunks, mock_threads_max () + 1, errors);
+    g_errors += errors;
+    return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+    static const mock_segment_t uneven[] =
+    {
+        {UVL_LOAD_CHUNK * 3 + 0x123, 0x2000},   // ends inside a chunk
+        {0, 0},                                 // empty
+        {0x10, UVL_LOAD_CHUNK * 2},             // mostly zero
+        {0, 0},                                 // empty, next to another empty one
+        {0, 0},
+        {UVL_LOAD_CHUNK, 0},                    // exactly one chunk
+        {0, UVL_LOAD_CHUNK - 4},                // only zero
+        {UVL_LOAD_CHUNK - 1, 2},                // zero crosses a chunk
+    };
+    static const mock_segment_t small[] =
+    {
+        {0x100, 0x100},
+    };
+    static const mock_segment_t last_empty[] =
+    {
+        {UVL_LOAD_CHUNK + 8, 8},
+        {0, 0},
+    };
+
+    mock_run ("uneven serial", uneven, sizeof (uneven) / sizeof (uneven[0]), 1);
+    mock_run ("uneven parallel", uneven, sizeof (uneven) / sizeof (uneven[0]), UVL_LOAD_MAX_THREADS);
+    mock_run ("one chunk", small, sizeof (small) / sizeof (small[0]), UVL_LOAD_MAX_THREADS);
+    mock_run ("last empty", last_empty, sizeof (last_empty) / sizeof (last_empty[0]), UVL_LOAD_MAX_THREADS);
+    if (g_errors > 0)
+    {
+        printf ("%d errors.\n", g_errors);
+        return 1;
+    }
+    return 0;
+}
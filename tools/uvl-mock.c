@@ -0,0 +1,295 @@
+/*
+ * uvl-mock.c - Host replacements for the target's imports and utilities
+ * Copyright 2012 Yifan Lu
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Imports a mock needs to behave differently are defined weak here, so
+// the mock's own definition replaces them. Memory blocks are mapped in
+// the low 4GB, so pointers the loader keeps as u32_t stay valid.
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "uvl-mock.h"
+
+#define MOCK_WEAK           __attribute__((weak))
+
+typedef struct
+{
+    pthread_t       thread;
+    int             (*entry) (u32_t arglen, void *argp);
+    void            *argp;
+    u32_t           arglen;
+    int             used;
+} mock_thread_t;
+
+typedef struct
+{
+    void            *base;
+    u32_t           size;
+} mock_block_t;
+
+static mock_thread_t g_threads[MOCK_THREADS];
+static mock_block_t g_blocks[MOCK_BLOCKS];
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static u32_t g_max_threads;
+
+void psvUnlockMem (void) {}
+void psvLockMem (void) {}
+
+/** Returns the most threads alive at once since the last call */
+u32_t
+mock_threads_max (void)
+{
+    u32_t max;
+
+    pthread_mutex_lock (&g_lock);
+    max = g_max_threads;
+    g_max_threads = 0;
+    pthread_mutex_unlock (&g_lock);
+    return max;
+}
+
+/** Returns the number of memory blocks not freed */
+u32_t
+mock_blocks_used (void)
+{
+    u32_t used;
+    u32_t i;
+
+    pthread_mutex_lock (&g_lock);
+    for (used = 0, i = 0; i < MOCK_BLOCKS; i++)
+    {
+        used += g_blocks[i].base != NULL;
+    }
+    pthread_mutex_unlock (&g_lock);
+    return used;
+}
+
+static void *
+mock_thread_entry (void *arg)
+{
+    mock_thread_t *thread = arg;
+
+    thread->entry (thread->arglen, thread->argp);
+    return NULL;
+}
+
+PsvUID
+sceKernelCreateThread (const char *name, int (*entry) (u32_t arglen, void *argp), int priority, int stack, u32_t attr, int affinity, void *opt)
+{
+    PsvUID i;
+    u32_t used;
+    u32_t j;
+
+    pthread_mutex_lock (&g_lock);
+    for (i = 0; i < MOCK_THREADS && g_threads[i].used; i++);
+    if (i < MOCK_THREADS)
+    {
+        memset (&g_threads[i], 0, sizeof (mock_thread_t));
+        g_threads[i].used = 1;
+        g_threads[i].entry = entry;
+    }
+    for (used = 0, j = 0; j < MOCK_THREADS; j++)
+    {
+        used += g_threads[j].used;
+    }
+    if (used > g_max_threads)
+    {
+        g_max_threads = used;
+    }
+    pthread_mutex_unlock (&g_lock);
+    return i < MOCK_THREADS ? i : -1;
+}
+
+int
+sceKernelStartThread (PsvUID thid, u32_t arglen, void *argp)
+{
+    // arguments are copied like the kernel does
+    g_threads[thid].argp = malloc (arglen);
+    memcpy (g_threads[thid].argp, argp, arglen);
+    g_threads[thid].arglen = arglen;
+    return pthread_create (&g_threads[thid].thread, NULL, mock_thread_entry, &g_threads[thid]) == 0 ? 0 : -1;
+}
+
+int
+sceKernelWaitThreadEnd (PsvUID thid, int *status, u32_t *timeout)
+{
+    pthread_join (g_threads[thid].thread, NULL);
+    *status = 0;
+    return 0;
+}
+
+int
+sceKernelDeleteThread (PsvUID thid)
+{
+    pthread_mutex_lock (&g_lock);
+    free (g_threads[thid].argp);
+    g_threads[thid].used = 0;
+    pthread_mutex_unlock (&g_lock);
+    return 0;
+}
+
+int
+sceKernelDelayThread (u32_t delay)
+{
+    usleep (delay);
+    return 0;
+}
+
+u32_t
+sceKernelGetSystemTimeLow (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (u32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+PsvUID
+sceKernelAllocMemBlock (const char *name, int type, u32_t size, void *opt)
+{
+    PsvUID i;
+    void *base;
+
+    pthread_mutex_lock (&g_lock);
+    for (i = 0; i < MOCK_BLOCKS && g_blocks[i].base != NULL; i++);
+    base = MAP_FAILED;
+    if (i < MOCK_BLOCKS && (base = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0)) != MAP_FAILED)
+    {
+        g_blocks[i].base = base;
+        g_blocks[i].size = size;
+    }
+    pthread_mutex_unlock (&g_lock);
+    return base != MAP_FAILED ? i : -1;
+}
+
+PsvUID
+sceKernelAllocCodeMemBlock (const char *name, u32_t size)
+{
+    return sceKernelAllocMemBlock (name, 0, size, NULL);
+}
+
+int
+sceKernelGetMemBlockBase (PsvUID uid, void **base)
+{
+    if (uid < 0 || uid >= MOCK_BLOCKS || g_blocks[uid].base == NULL)
+    {
+        return -1;
+    }
+    *base = g_blocks[uid].base;
+    return 0;
+}
+
+PsvUID
+sceKernelFindMemBlockByAddr (const void *addr, u32_t size)
+{
+    PsvUID i;
+
+    for (i = 0; i < MOCK_BLOCKS; i++)
+    {
+        if (g_blocks[i].base != NULL && (u8_t*)addr >= (u8_t*)g_blocks[i].base && (u8_t*)addr < (u8_t*)g_blocks[i].base + g_blocks[i].size)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int
+sceKernelFreeMemBlock (PsvUID uid)
+{
+    if (uid < 0 || uid >= MOCK_BLOCKS || g_blocks[uid].base == NULL)
+    {
+        return -1;
+    }
+    pthread_mutex_lock (&g_lock);
+    munmap (g_blocks[uid].base, g_blocks[uid].size);
+    g_blocks[uid].base = NULL;
+    pthread_mutex_unlock (&g_lock);
+    return 0;
+}
+
+MOCK_WEAK int sceKernelStopUnloadModule (PsvUID modid, u32_t arglen, void *argp, int flags, void *opt, int *status) { return -1; }
+MOCK_WEAK int sceKernelExitDeleteThread (int status) { return -1; }
+MOCK_WEAK int sceKernelGetModuleList (int flags, PsvUID *modids, u32_t *num) { return -1; }
+MOCK_WEAK int sceKernelGetModuleInfo (PsvUID modid, void *info) { return -1; }
+MOCK_WEAK PsvSSize sceIoWrite (PsvUID fd, const void *data, u32_t size) { return -1; }
+MOCK_WEAK int sceIoClose (PsvUID fd) { return -1; }
+MOCK_WEAK PsvOff sceIoRead (PsvUID fd, void *data, u32_t size) { return -1; }
+MOCK_WEAK PsvOff sceIoLseek (PsvUID fd, u64_t offset, int whence) { return -1; }
+MOCK_WEAK PsvUID sceIoOpen (const char *file, int flags, int mode) { return -1; }
+MOCK_WEAK PsvUID sceIoDopen (const char *dir) { return -1; }
+MOCK_WEAK int sceIoDread (PsvUID fd, PsvIoDirent *dir) { return -1; }
+MOCK_WEAK int sceIoDclose (PsvUID fd) { return -1; }
+MOCK_WEAK int sceIoGetstat (const char *file, PsvIoStat *stat) { return -1; }
+MOCK_WEAK int sceIoMkdir (const char *dir, int mode) { return -1; }
+MOCK_WEAK int sceDisplayGetFrameBuf (PsvDisplayFrameBuf *frame, int sync) { return -1; }
+
+char *
+memstr (char *haystack, int h_length, char *needle, int n_length)
+{
+    int i;
+
+    for (i = 0; i + n_length <= h_length; i++)
+    {
+        if (memcmp (&haystack[i], needle, n_length) == 0)
+        {
+            return &haystack[i];
+        }
+    }
+    return NULL;
+}
+
+int
+nid_find (const u32_t *table, u32_t length, const u32_t *needles, u32_t n_needles)
+{
+    u32_t i, j;
+
+    for (i = 0; i < length; i++)
+    {
+        for (j = 0; j < n_needles; j++)
+        {
+            if (table[i] == needles[j])
+            {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+u32_t
+crc32 (u32_t crc, const void *data, u32_t length)
+{
+    const u8_t *p = data;
+    u32_t i;
+
+    crc = ~crc;
+    while (length--)
+    {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+u32_t
+crc32_copy (u32_t crc, void *dst, const void *src, u32_t length)
+{
+    memcpy (dst, src, length);
+    return crc32 (crc, src, length);
+}
@@ -0,0 +1,54 @@
+/*
+ * uvl-mock.h - Host replacements for the target's imports and utilities
+ * Copyright 2012 Yifan Lu
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Included by the host mocks before the loader source they test, and
+// linked with uvl-mock.c. Threads are pthreads, memory blocks are taken
+// from malloc and the other imports fail unless a mock defines its own.
+// utils.h declares the C library with the target's types, so the
+// utilities the loader uses are declared here instead.
+#ifndef UVL_MOCK
+#define UVL_MOCK
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UVL_HOST
+#define UVL_UTILS
+#undef NULL
+#include "../types.h"
+#include "../scefuncs.h"
+
+#define DEBUG_LOGGING       0
+#define IF_DEBUG            if (DEBUG_LOGGING)
+#define IF_VERBOSE          if (0)
+#define LOG(args...)        (printf (args), printf ("\n"))
+#define MAX_LOG_LENGTH      1024
+
+#define MOCK_THREADS        64      // threads alive at once
+#define MOCK_BLOCKS         64      // memory blocks allocated at once
+
+char *memstr (char *haystack, int h_length, char *needle, int n_length);
+int nid_find (const u32_t *table, u32_t length, const u32_t *needles, u32_t n_needles);
+u32_t crc32 (u32_t crc, const void *data, u32_t length);
+u32_t crc32_copy (u32_t crc, void *dst, const void *src, u32_t length);
+
+u32_t mock_threads_max (void);
+u32_t mock_blocks_used (void);
+
+#endif
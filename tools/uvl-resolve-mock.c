@@ -0,0 +1,341 @@
+/*
+ * uvl-resolve-mock.c - Runs the resolve table against a mock module
+ * Copyright 2012 Yifan Lu
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host tool, built with the host compiler. resolve.c is compiled in with
+// the imports from uvl-mock.c. One mock module is loaded, with an export
+// table and an import table holding a syscall stub and a function stub.
+// Every combination of search flags is added to a fresh table and the
+// mock fails if an entry is missing or should not be there, or if the
+// syscall snapshot is used when it should not be or not used when it
+// should be. Then reader threads look up entries while the table is
+// added to and sorted. The mock fails if a lookup misses an added entry
+// or returns a wrong one, or if a replaced table is not freed. Tables
+// are unmapped when freed, so one freed under a reader crashes the mock.
+#include "uvl-mock.h"
+
+#define MOCK_NAME           "MockModule"
+#define MOCK_SIZE           0x1000  // size of the module's only segment
+#define MOCK_EXPORT_NID     0xE0000001
+#define MOCK_SYSCALL_NID    0xE0000002
+#define MOCK_FUNCTION_NID   0xE0000003
+#define MOCK_SNAPSHOT_NID   0xE0000004
+#define MOCK_SYSCALL        0x123
+#define MOCK_FUNCTION       0x81234568
+#define ARM_MOVW_R12(imm)   (0xE300C000 | (((imm) & 0xF000) << 4) | ((imm) & 0xFFF))
+#define ARM_MOVT_R12(imm)   (0xE340C000 | (((imm) & 0xF000) << 4) | ((imm) & 0xFFF))
+#define ARM_SVC             0xEF000000
+#define ARM_BX_LR           0xE12FFF1E
+#define ARM_BX_R12          0xE12FFF1C
+#define MOCK_READERS        4
+#define MOCK_ENTRIES        0x8000  // entries added while readers look up
+#define MOCK_SORT_EVERY     0x400   // entries added between sorts
+#define MOCK_VALUE_KEY      0x5A5AA5A5  // entries hold their NID XOR this
+
+#include "../resolve.c"
+
+/** Layout of the mock module's segment */
+typedef struct
+{
+    u32_t               pad;                ///< Keeps the module info off the segment start
+    module_info_t       info;
+    module_exports_t    exports;
+    module_imports_t    imports;
+    u32_t               export_nids[1];
+    void                *export_entries[1];
+    u32_t               import_nids[2];
+    void                *import_entries[2];
+    u32_t               stubs[2][STUB_FUNC_SIZE / sizeof (u32_t)];
+} mock_module_t;
+
+/** Shared by the thread adding entries and the readers */
+typedef struct
+{
+    u32_t               nids[MOCK_ENTRIES]; ///< NIDs in the order they are added
+    volatile u32_t      added;              ///< NIDs added, published after each entry
+    volatile u32_t      stop;               ///< Set to stop the readers
+    volatile u32_t      lookups;            ///< Lookups by all readers
+    volatile u32_t      errors;             ///< Lookups that missed or returned a wrong entry
+} mock_readers_t;
+
+static mock_module_t *g_module;
+static u32_t g_snapshot_gets;
+static int g_snapshot_result;
+static int g_errors;
+
+/** Builds the mock module in a memory block of its own */
+static int
+mock_module (void)
+{
+    PsvUID block;
+    void *base;
+    mock_module_t *mod;
+
+    if ((block = sceKernelAllocMemBlock ("MockModule", 0, MOCK_SIZE, NULL)) < 0 || sceKernelGetMemBlockBase (block, &base) < 0)
+    {
+        return -1;
+    }
+    mod = base;
+    mod->info.modattribute = MOD_INFO_VALID_ATTR;
+    mod->info.modversion = MOD_INFO_VALID_VER;
+    strcpy (mod->info.modname, MOCK_NAME);
+    mod->info.ent_top = (u32_t)&mod->exports - (u32_t)mod;
+    mod->info.ent_end = mod->info.ent_top + sizeof (module_exports_t);
+    mod->info.stub_top = (u32_t)&mod->imports - (u32_t)mod;
+    mod->info.stub_end = mod->info.stub_top + sizeof (module_imports_t);
+    mod->exports.size = sizeof (module_exports_t);
+    mod->exports.num_functions = 1;
+    mod->exports.nid_table = mod->export_nids;
+    mod->exports.entry_table = mod->export_entries;
+    mod->export_nids[0] = MOCK_EXPORT_NID;
+    mod->export_entries[0] = (void*)MOCK_FUNCTION;
+    mod->imports.size = sizeof (module_imports_t);
+    mod->imports.num_functions = 2;
+    mod->imports.lib_name = MOCK_NAME;
+    mod->imports.func_nid_table = mod->import_nids;
+    mod->imports.func_entry_table = mod->import_entries;
+    mod->import_nids[0] = MOCK_SYSCALL_NID;
+    mod->import_nids[1] = MOCK_FUNCTION_NID;
+    mod->import_entries[0] = mod->stubs[0];
+    mod->import_entries[1] = mod->stubs[1];
+    // stubs as the kernel resolved them
+    mod->stubs[0][0] = ARM_MOVW_R12 (MOCK_SYSCALL);
+    mod->stubs[0][1] = ARM_SVC;
+    mod->stubs[0][2] = ARM_BX_LR;
+    mod->stubs[1][0] = ARM_MOVW_R12 (MOCK_FUNCTION & 0xFFFF);
+    mod->stubs[1][1] = ARM_MOVT_R12 (MOCK_FUNCTION >> 16);
+    mod->stubs[1][2] = ARM_BX_R12;
+    g_module = mod;
+    return 0;
+}
+
+int
+sceKernelGetModuleList (int flags, PsvUID *modids, u32_t *num)
+{
+    modids[0] = 1;
+    *num = 1;
+    return 0;
+}
+
+int
+sceKernelGetModuleInfo (PsvUID modid, void *info)
+{
+    loaded_module_info_t *m_mod_info = info;
+
+    strcpy (m_mod_info->module_name, MOCK_NAME);
+    m_mod_info->segments[0].vaddr = g_module;
+    m_mod_info->segments[0].memsz = MOCK_SIZE;
+    return 0;
+}
+
+int
+uvl_snapshot_get (PsvUID *mod_list, u32_t num_loaded, snapshot_t **snapshot)
+{
+    g_snapshot_gets++;
+    *snapshot = NULL;
+    return g_snapshot_result;
+}
+
+int
+uvl_snapshot_add_all (snapshot_t *snapshot)
+{
+    resolve_entry_t entry;
+
+    entry.nid = MOCK_SNAPSHOT_NID;
+    entry.type = RESOLVE_TYPE_SYSCALL;
+    entry.value.value = MOCK_SYSCALL;
+    return uvl_resolve_table_add (&entry);
+}
+
+/** Checks an entry is in the table if @a expected, or is not */
+static void
+mock_expect (const char *name, u32_t nid, int expected, u32_t type, u32_t value)
+{
+    resolve_entry_t *entry;
+
+    entry = uvl_resolve_table_get (nid);
+    if (!expected && entry != NULL)
+    {
+        printf ("%s: NID 0x%08X should not be added.\n", name, nid);
+        g_errors++;
+    }
+    else if (expected && (entry == NULL || entry->type != type || entry->value.value != value))
+    {
+        printf ("%s: NID 0x%08X not added as type %u value 0x%08X.\n", name, nid, type, value);
+        g_errors++;
+    }
+}
+
+/** Adds the mock module to a fresh table with the search flags @a type */
+static void
+mock_add_all (const char *name, int type, int snapshot_result)
+{
+    int snapshot;
+
+    g_snapshot_gets = 0;
+    g_snapshot_result = snapshot_result;
+    if (uvl_resolve_table_initialize () < 0 || uvl_resolve_add_all_modules (type) < 0)
+    {
+        printf ("%s: module not added.\n", name);
+        g_errors++;
+        return;
+    }
+    snapshot = (type & RESOLVE_MOD_IMPS) && (type & RESOLVE_IMPS_SVC_ONLY);
+    if (g_snapshot_gets != snapshot)
+    {
+        printf ("%s: snapshot read %u times.\n", name, g_snapshot_gets);
+        g_errors++;
+    }
+    snapshot = snapshot && snapshot_result == 0;
+    mock_expect (name, MOCK_SNAPSHOT_NID, snapshot, RESOLVE_TYPE_SYSCALL, MOCK_SYSCALL);
+    mock_expect (name, MOCK_EXPORT_NID, type & RESOLVE_MOD_EXPS, RESOLVE_TYPE_FUNCTION, MOCK_FUNCTION);
+    mock_expect (name, MOCK_SYSCALL_NID, (type & RESOLVE_MOD_IMPS) && !snapshot, RESOLVE_TYPE_SYSCALL, MOCK_SYSCALL);
+    mock_expect (name, MOCK_FUNCTION_NID, (type & RESOLVE_MOD_IMPS) && !(type & RESOLVE_IMPS_SVC_ONLY), RESOLVE_TYPE_FUNCTION, MOCK_FUNCTION);
+    printf ("%s: %u entries\n", name, g_resolve_table->length);
+    uvl_resolve_table_destroy ();
+}
+
+/** Looks up random entries among those already added */
+static int
+mock_reader (u32_t arglen, void *argp)
+{
+    mock_readers_t *readers;
+    resolve_entry_t entry;
+    u32_t lookups;
+    u32_t errors;
+    u32_t added;
+    u32_t seed;
+    u32_t nid;
+    u32_t i;
+
+    readers = *(mock_readers_t**)argp;
+    lookups = 0;
+    errors = 0;
+    seed = (u32_t)(uintptr_t)&entry;
+    while (!readers->stop)
+    {
+        if ((added = readers->added) == 0)
+        {
+            continue;
+        }
+        __sync_synchronize (); // count before NIDs
+        seed = seed * 1664525 + 1013904223;
+        i = (seed >> 8) % added;
+        if ((seed & 0x7) == 0)
+        {
+            i = added - 1; // newest entry, the likeliest to be torn
+        }
+        nid = readers->nids[i];
+        if (uvl_resolve_table_lookup (nid, &entry) < 0 || entry.nid != nid || entry.value.value != (nid ^ MOCK_VALUE_KEY))
+        {
+            errors++;
+        }
+        lookups++;
+    }
+    __sync_fetch_and_add (&readers->lookups, lookups);
+    __sync_fetch_and_add (&readers->errors, errors);
+    return 0;
+}
+
+/** Adds and sorts entries while readers look them up */
+static void
+mock_concurrent (void)
+{
+    static mock_readers_t readers;
+    mock_readers_t *readers_ptr;
+    PsvUID threads[MOCK_READERS];
+    resolve_entry_t entry;
+    u32_t blocks;
+    u32_t sorts;
+    u32_t nid;
+    int status;
+    u32_t i;
+
+    blocks = mock_blocks_used ();
+    if (uvl_resolve_table_initialize () < 0)
+    {
+        printf ("concurrent: table not created.\n");
+        g_errors++;
+        return;
+    }
+    readers_ptr = &readers;
+    for (i = 0; i < MOCK_READERS; i++)
+    {
+        threads[i] = sceKernelCreateThread ("mockreader", mock_reader, 0, 0, 0, 0, NULL);
+        sceKernelStartThread (threads[i], sizeof (mock_readers_t*), &readers_ptr);
+    }
+    entry.type = RESOLVE_TYPE_FUNCTION;
+    nid = 1;
+    sorts = 0;
+    for (i = 0; i < MOCK_ENTRIES; i++)
+    {
+        nid = nid * 1664525 + 1013904223;
+        readers.nids[i] = nid;
+        entry.nid = nid;
+        entry.value.value = nid ^ MOCK_VALUE_KEY;
+        if (uvl_resolve_table_add (&entry) < 0)
+        {
+            break;
+        }
+        __sync_synchronize (); // NID before count
+        readers.added = i + 1;
+        if ((i + 1) % MOCK_SORT_EVERY == 0)
+        {
+            uvl_resolve_table_sort ();
+            sorts++;
+        }
+    }
+    readers.stop = 1;
+    for (i = 0; i < MOCK_READERS; i++)
+    {
+        sceKernelWaitThreadEnd (threads[i], &status, NULL);
+        sceKernelDeleteThread (threads[i]);
+    }
+    if (readers.added != MOCK_ENTRIES || readers.errors > 0)
+    {
+        printf ("concurrent: %u of %u entries added, %u of %u lookups failed.\n", readers.added, MOCK_ENTRIES, readers.errors, readers.lookups);
+        g_errors++;
+    }
+    // only the new table is left from the sorts
+    if (mock_blocks_used () != blocks + 1)
+    {
+        printf ("concurrent: %u blocks left after %u sorts.\n", mock_blocks_used () - blocks, sorts);
+        g_errors++;
+    }
+    printf ("concurrent: %u entries, %u sorts, %u lookups on %u threads\n", readers.added, sorts, readers.lookups, MOCK_READERS);
+    uvl_resolve_table_destroy ();
+}
+
+int
+main (int argc, char *argv[])
+{
+    if (mock_module () < 0)
+    {
+        printf ("Cannot build mock module.\n");
+        return 1;
+    }
+    mock_add_all ("exports", RESOLVE_MOD_EXPS, 0);
+    mock_add_all ("imports", RESOLVE_MOD_IMPS, 0);
+    mock_add_all ("imports and exports", RESOLVE_MOD_IMPS | RESOLVE_MOD_EXPS, 0);
+    mock_add_all ("syscalls from snapshot", RESOLVE_MOD_IMPS | RESOLVE_MOD_EXPS | RESOLVE_IMPS_SVC_ONLY, 0);
+    mock_add_all ("syscalls from stubs", RESOLVE_MOD_IMPS | RESOLVE_MOD_EXPS | RESOLVE_IMPS_SVC_ONLY, -1);
+    mock_concurrent ();
+    if (g_errors > 0)
+    {
+        printf ("%d errors.\n", g_errors);
+        return 1;
+    }
+    return 0;
+}
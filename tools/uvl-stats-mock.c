@@ -0,0 +1,174 @@
+/*
+ * uvl-stats-mock.c - Runs the SCE call statistics against mock imports
+ * Copyright 2012 Yifan Lu
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host tool, built with the host compiler. scefuncs.c is compiled in with
+// UVL_STATS, and every import stub is a mock that takes a set time on a
+// mock clock and returns a value of its own. Calls are made through the
+// wrappers and the dump is compared with the report they should give.
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// replace the target's logging with the declarations below
+#define UVL_HOST
+#define UVL_STATS
+#define UVL_UTILS
+#undef NULL
+#include "../types.h"
+
+#define DEBUG_LOGGING       0
+#define IF_DEBUG            if (DEBUG_LOGGING)
+#define IF_VERBOSE          if (0)
+#define LOG(args...)        mock_log (args)
+#define MAX_LOG_LENGTH      1024
+
+#define MOCK_RESULT(index)  (0x100 + (index))   // what the mock of each import returns
+#define MOCK_OFFSET         0x100000004ULL      // needs both words of the argument
+
+void mock_log (const char *format, ...);
+
+#include "../scefuncs.c"
+
+static char g_log[0x1000];
+static u32_t g_clock;
+static u32_t g_latency[UVL_STATS_COUNT];
+static sce_stats_t g_stats[UVL_STATS_COUNT];
+static int g_errors;
+
+void
+mock_log (const char *format, ...)
+{
+    va_list args;
+    u32_t length;
+
+    length = strlen (g_log);
+    va_start (args, format);
+    vsnprintf (&g_log[length], sizeof (g_log) - length, format, args);
+    va_end (args);
+    length = strlen (g_log);
+    snprintf (&g_log[length], sizeof (g_log) - length, "\n");
+}
+
+void psvUnlockMem (void) {}
+void psvLockMem (void) {}
+int uvl_resolve_loader (u32_t nid, void *libkernel_base, void *stub) { return -1; }
+resolve_entry_t *uvl_resolve_table_get (u32_t nid) { return NULL; }
+int uvl_resolve_entry_to_import_stub (resolve_entry_t *entry, void *stub) { return -1; }
+
+/**
+ * Advances the mock clock by the time of the import called. The memory
+ * block calls give the statistics a buffer, and the offset sceIoLseek
+ * is given is checked to be passed through whole.
+ */
+static u32_t
+mock_call (u32_t index, ...)
+{
+    va_list args;
+    u64_t offset;
+
+    va_start (args, index);
+    switch (index)
+    {
+        case UVL_STATS_sceKernelGetSystemTimeLow:
+            va_end (args);
+            return g_clock;
+        case UVL_STATS_sceKernelGetMemBlockBase:
+            va_arg (args, PsvUID);
+            *va_arg (args, void**) = g_stats;
+            break;
+        case UVL_STATS_sceIoLseek:
+            va_arg (args, PsvUID);
+            offset = va_arg (args, u64_t);
+            if (offset != MOCK_OFFSET)
+            {
+                printf ("sceIoLseek given offset 0x%llX.\n", (unsigned long long)offset);
+                g_errors++;
+            }
+            break;
+    }
+    va_end (args);
+    g_clock += g_latency[index];
+    return MOCK_RESULT (index);
+}
+
+#define MOCK_ARGS(args...)  , ##args
+#define MOCK_STUB(type, name, params, args) \
+    type uvl_stub_##name params { return (type)mock_call (UVL_STATS_##name MOCK_ARGS args); }
+UVL_SCE_FUNCTIONS(MOCK_STUB)
+
+int
+main (int argc, char *argv[])
+{
+    static const char expected[] =
+        "SCE call statistics at mock:\n"
+        "sceKernelDelayThread: 1 calls, 70000 us total, 70000 us max\n"
+        "sceKernelDelayThread: log2 us buckets 15:1\n"
+        "sceIoClose: 2 calls, 0 us total, 0 us max\n"
+        "sceIoClose: log2 us buckets 0:2\n"
+        "sceIoRead: 3 calls, 9 us total, 3 us max\n"
+        "sceIoRead: log2 us buckets 2:3\n"
+        "sceIoLseek: 1 calls, 1 us total, 1 us max\n"
+        "sceIoLseek: log2 us buckets 1:1\n"
+        "sceIoOpen: 1 calls, 100 us total, 100 us max\n"
+        "sceIoOpen: log2 us buckets 7:1\n";
+    char buffer[4];
+    int i;
+
+    // nothing is counted or dumped before the statistics exist
+    sceIoClose (0);
+    uvl_stats_dump ("none");
+    if (uvl_stats_init () < 0 || g_sce_stats != g_stats)
+    {
+        printf ("Statistics not set up.\n");
+        return 1;
+    }
+    g_latency[UVL_STATS_sceIoRead] = 3;
+    g_latency[UVL_STATS_sceIoLseek] = 1;
+    g_latency[UVL_STATS_sceIoOpen] = 100;
+    g_latency[UVL_STATS_sceKernelDelayThread] = 70000; // past the last bucket
+    if (sceIoOpen ("ux0:/mock", PSP2_O_RDONLY, 0) != MOCK_RESULT (UVL_STATS_sceIoOpen))
+    {
+        printf ("Result of sceIoOpen not passed through.\n");
+        g_errors++;
+    }
+    for (i = 0; i < 3; i++)
+    {
+        sceIoRead (1, buffer, sizeof (buffer));
+    }
+    if (sceIoLseek (1, MOCK_OFFSET, PSP2_SEEK_SET) != MOCK_RESULT (UVL_STATS_sceIoLseek))
+    {
+        printf ("Result of sceIoLseek not passed through.\n");
+        g_errors++;
+    }
+    sceIoClose (1);
+    sceIoClose (1);
+    sceKernelDelayThread (70000);
+    uvl_stats_dump ("mock");
+    printf ("%s", g_log);
+    if (strcmp (g_log, expected) != 0)
+    {
+        printf ("Expected:\n%s", expected);
+        g_errors++;
+    }
+    if (g_errors > 0)
+    {
+        printf ("%d errors.\n", g_errors);
+        return 1;
+    }
+    return 0;
+}
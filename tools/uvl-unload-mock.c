@@ -0,0 +1,182 @@
+/*
+ * uvl-unload-mock.c - Runs the module unloader against mock modules
+ * Copyright 2012 Yifan Lu
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host tool, built with the host compiler. cleanup.c is compiled in with
+// the imports from uvl-mock.c. Each mock module takes a set time to stop,
+// so the time of the dependency waves can be compared with unloading
+// every module in turn. The mock fails if a module is stopped while a
+// module importing from it is still loaded, unless that module is stopped
+// on its own to break a cycle.
+#include <unistd.h>
+#include "uvl-mock.h"
+
+#define MOCK_MODULES        24
+#define MOCK_LATENCY        2000    // default microseconds to stop a module
+#define MOCK_LIB(module)    (0x4C000000 | (module))
+
+#include "../cleanup.c"
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static unload_job_t *g_jobs;
+static u32_t g_num_jobs;
+static u32_t g_latency[MOCK_MODULES];
+static int g_stopped[MOCK_MODULES];
+static int g_running;
+static int g_breaking;
+static int g_errors;
+
+/**
+ * Stops a mock module. A module something loaded still imports from may
+ * only be stopped to break a cycle, with no other module stopping.
+ */
+int
+sceKernelStopUnloadModule (PsvUID modid, u32_t arglen, void *argp, int flags, void *opt, int *status)
+{
+    u32_t i;
+    int breaking;
+
+    pthread_mutex_lock (&g_lock);
+    if (g_breaking)
+    {
+        printf ("%s stopped while a cycle is being broken.\n", g_jobs[modid].name);
+        g_errors++;
+    }
+    breaking = 0;
+    for (i = 0; i < g_num_jobs; i++)
+    {
+        if (!g_stopped[i] && uvl_unload_job_depends (&g_jobs[i], &g_jobs[modid]))
+        {
+            breaking = 1;
+            if (g_running > 0)
+            {
+                printf ("%s stopped with others while %s still imports from it.\n", g_jobs[modid].name, g_jobs[i].name);
+                g_errors++;
+            }
+        }
+    }
+    g_breaking = breaking;
+    g_running++;
+    pthread_mutex_unlock (&g_lock);
+    usleep (g_latency[modid]);
+    pthread_mutex_lock (&g_lock);
+    g_running--;
+    g_breaking = 0;
+    g_stopped[modid] = 1;
+    pthread_mutex_unlock (&g_lock);
+    *status = 0;
+    return 0;
+}
+
+// only reached through uvl_unload_job_init, which the mock does not call
+u32_t uvl_resolve_table_pin (loaded_module_info_t *m_mod_info) { return 0; }
+int uvl_resolve_find_module_info (loaded_module_info_t *m_mod_info, module_info_t **mod_info) { return -1; }
+void uvl_module_ports_begin (module_ports_iter_t *iter, void *start, void *end, int kind, u32_t delta) {}
+module_ports_t *uvl_module_ports_next (module_ports_iter_t *iter) { return NULL; }
+
+/**
+ * Builds mock modules. Module i exports one library and imports from
+ * its parent in a binary tree and from module 0, like most modules
+ * import from the kernel library. With @a cycle, the first two leaves
+ * also import from each other.
+ */
+static void
+mock_modules (unload_job_t *jobs, u32_t count, u32_t latency, int cycle)
+{
+    u32_t i, j;
+
+    memset (jobs, 0, count * sizeof (unload_job_t));
+    memset (g_stopped, 0, sizeof (g_stopped));
+    for (i = 0; i < count; i++)
+    {
+        jobs[i].modid = i;
+        sprintf (jobs[i].name, "Mock%u", i);
+        jobs[i].exports[jobs[i].num_exports++] = MOCK_LIB (i);
+        if (i > 0)
+        {
+            jobs[i].imports[jobs[i].num_imports++] = MOCK_LIB ((i - 1) >> 1);
+        }
+        if (i > 2)
+        {
+            jobs[i].imports[jobs[i].num_imports++] = MOCK_LIB (0);
+        }
+        g_latency[i] = latency + (i % 3) * (latency >> 1);
+    }
+    if (cycle)
+    {
+        jobs[count - 1].imports[jobs[count - 1].num_imports++] = MOCK_LIB (count - 2);
+        jobs[count - 2].imports[jobs[count - 2].num_imports++] = MOCK_LIB (count - 1);
+    }
+    for (i = 0; i < count; i++)
+    {
+        for (j = 0; j < count; j++)
+        {
+            if (uvl_unload_job_depends (&jobs[j], &jobs[i]))
+            {
+                jobs[i].dependents++;
+            }
+        }
+    }
+    g_jobs = jobs;
+    g_num_jobs = count;
+}
+
+/** Unloads the mock modules and checks all of them were stopped */
+static int
+mock_run (const char *name, u32_t latency, int cycle)
+{
+    unload_job_t jobs[MOCK_MODULES];
+    u32_t serial;
+    u32_t start;
+    u32_t time;
+    u32_t waves;
+    u32_t i;
+
+    mock_modules (jobs, MOCK_MODULES, latency, cycle);
+    serial = 0;
+    for (i = 0; i < MOCK_MODULES; i++)
+    {
+        serial += g_latency[i];
+    }
+    start = sceKernelGetSystemTimeLow ();
+    waves = uvl_unload_jobs (jobs, MOCK_MODULES);
+    time = sceKernelGetSystemTimeLow () - start;
+    for (i = 0; i < MOCK_MODULES; i++)
+    {
+        if (!jobs[i].done || !g_stopped[i])
+        {
+            printf ("%s was not unloaded.\n", jobs[i].name);
+            g_errors++;
+        }
+    }
+    printf ("%s: %u modules in %u waves, %u us, %u us one at a time, %.2fx\n", name, MOCK_MODULES, waves, time, serial, (double)serial / time);
+    return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+    u32_t latency;
+
+    latency = argc > 1 ? strtoul (argv[1], NULL, 0) : MOCK_LATENCY;
+    mock_run ("tree", latency, 0);
+    mock_run ("cycle", latency, 1);
+    if (g_errors > 0)
+    {
+        printf ("%d errors.\n", g_errors);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * uvl-utils-mock.c - Runs the NID search against a plain search
+ * Copyright 2012 Yifan Lu
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host tool, built with the host compiler, once as is and once with
+// USE_NEON and tools/host/arm_neon.h. utils.c is compiled in with the C
+// library it defines renamed, so the host's is left alone. nid_find is
+// run on tables of lengths around the eight element block, with misses
+// and with matches in every position, and fails if it does not give the
+// index a plain search gives.
+#define UVL_HOST
+#define memcpy      uvl_memcpy
+#define strcpy      uvl_strcpy
+#define memcmp      uvl_memcmp
+#define strcmp      uvl_strcmp
+#define strncmp     uvl_strncmp
+#define memset      uvl_memset
+#define strlen      uvl_strlen
+#define qsort       uvl_qsort
+#define vsprintf    uvl_vsprintf
+#define sprintf     uvl_sprintf
+
+#include "../utils.c"
+
+#define MOCK_MAX_LENGTH     19      // two blocks and a tail
+#define MOCK_MISS           0xDEAD0000  // NIDs in no table
+
+#ifdef USE_NEON
+#define MOCK_PATH           "neon"
+#else
+#define MOCK_PATH           "scalar"
+#endif
+
+int printf (const char *format, ...);
+
+// only reached through logging and the console, which the mock does not use
+void psvUnlockMem (void) {}
+void psvLockMem (void) {}
+void uvl_console_print (console_t *console, const char *str) {}
+int uvl_console_flush (console_t *console, u32_t now, int force) { return 0; }
+PsvUID sceIoOpen (const char *file, int flags, int mode) { return -1; }
+PsvSSize sceIoWrite (PsvUID fd, const void *data, u32_t size) { return -1; }
+u32_t sceKernelGetSystemTimeLow (void) { return 0; }
+
+static int g_errors;
+
+/** Index of the first element of @a table equal to any needle, or -1 */
+static int
+mock_find (const u32_t *table, u32_t length, const u32_t *needles, u32_t n_needles)
+{
+    u32_t i, j;
+
+    for (i = 0; i < length; i++)
+    {
+        for (j = 0; j < n_needles; j++)
+        {
+            if (table[i] == needles[j])
+            {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+/** Checks nid_find gives what a plain search gives */
+static void
+mock_check (const char *name, const u32_t *table, u32_t length, const u32_t *needles, u32_t n_needles)
+{
+    int expected;
+    int found;
+
+    expected = mock_find (table, length, needles, n_needles);
+    found = nid_find (table, length, needles, n_needles);
+    if (found != expected)
+    {
+        printf ("%s: length %u, %u needles, found %d, expected %d.\n", name, length, n_needles, found, expected);
+        g_errors++;
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+    static const u32_t lengths[] = {0, 1, 7, 8, 9, 15, 16, 17, MOCK_MAX_LENGTH};
+    u32_t table[MOCK_MAX_LENGTH + 1];
+    u32_t needles[3];
+    u32_t length;
+    u32_t checks;
+    u32_t i, j, k;
+
+    checks = 0;
+    for (k = 0; k < sizeof (lengths) / sizeof (lengths[0]); k++)
+    {
+        length = lengths[k];
+        for (i = 0; i <= MOCK_MAX_LENGTH; i++)
+        {
+            table[i] = 0xE0000000 | (i * 0x101);
+        }
+        table[length] = MOCK_MISS + 1; // just past the end, must not be found
+        needles[0] = MOCK_MISS;
+        needles[1] = MOCK_MISS + 1;
+        mock_check ("miss", table, length, needles, 2);
+        mock_check ("no needles", table, length, table, 0);
+        checks += 2;
+        for (i = 0; i < length; i++)
+        {
+            // match at i alone, then with a later needle matching earlier
+            needles[0] = MOCK_MISS;
+            needles[1] = table[i];
+            mock_check ("one match", table, length, needles, 2);
+            for (j = 0; j < i; j++)
+            {
+                needles[2] = table[j];
+                mock_check ("two matches", table, length, needles, 3);
+            }
+            checks += 1 + i;
+        }
+        if (length > 1)
+        {
+            // the same NID twice, the first is found
+            table[length - 1] = table[0];
+            needles[0] = table[0];
+            mock_check ("repeated", table, length, needles, 1);
+            checks++;
+        }
+    }
+    printf ("%s: %u searches\n", MOCK_PATH, checks);
+    if (g_errors > 0)
+    {
+        printf ("%d errors.\n", g_errors);
+        return 1;
+    }
+    return 0;
+}
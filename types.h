@@ -11,7 +11,7 @@
 typedef unsigned char u8_t;             ///< Unsigned 8-bit type
 typedef unsigned short int u16_t;       ///< Unsigned 16-bit type
 typedef unsigned int u32_t;             ///< Unsigned 32-bit type
-typedef unsigned long int u64_t;        ///< Unsigned 64-bit type
+typedef unsigned long long u64_t;       ///< Unsigned 64-bit type
 /** @}*/
 
 /** \name SCE standard types
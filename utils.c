@@ -15,9 +15,14 @@
  * limitations under the License.
  */
 #include "config.h"
+#include "console.h"
 #include "scefuncs.h"
 #include "utils.h"
 
+#ifdef USE_NEON
+#include <arm_neon.h>
+#endif
+
 // Below is stolen from Android's Bionic
 
 /*-
@@ -364,6 +369,182 @@ memstr (char *haystack, ///< Where to search
     return boyer_moore (haystack, h_length, needle, n_length);
 }
 
+/********************************************//**
+ *  \brief Search for NIDs in a NID table
+ *  
+ *  Finds the first element of @a table equal 
+ *  to any of the @a needles. When built with 
+ *  @c USE_NEON, eight elements are compared 
+ *  at a time and only a block with a match 
+ *  is rescanned one by one.
+ *  \returns Index of the match or -1 if 
+ *  not found
+ ***********************************************/
+int
+nid_find (const u32_t *table,       ///< NIDs to search
+                u32_t length,       ///< Number of elements in @a table
+          const u32_t *needles,     ///< NIDs to find
+                u32_t n_needles)    ///< Number of elements in @a needles
+{
+    u32_t i, j;
+
+    i = 0;
+#ifdef USE_NEON
+    for (; i + 8 <= length; i += 8)
+    {
+        uint32x4_t lo = vld1q_u32 (&table[i]);
+        uint32x4_t hi = vld1q_u32 (&table[i + 4]);
+        uint32x4_t hits = vdupq_n_u32 (0);
+        uint32x2_t any;
+        for (j = 0; j < n_needles; j++)
+        {
+            uint32x4_t needle = vdupq_n_u32 (needles[j]);
+            hits = vorrq_u32 (hits, vceqq_u32 (lo, needle));
+            hits = vorrq_u32 (hits, vceqq_u32 (hi, needle));
+        }
+        any = vorr_u32 (vget_low_u32 (hits), vget_high_u32 (hits));
+        if ((vget_lane_u32 (any, 0) | vget_lane_u32 (any, 1)) != 0)
+        {
+            break; // match in this block, find it below
+        }
+    }
+#endif
+    for (; i < length; i++)
+    {
+        for (j = 0; j < n_needles; j++)
+        {
+            if (table[i] == needles[j])
+            {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+#define CRC32_POLY  0xEDB88320  ///< Reversed CRC-32 polynomial (zlib, PNG)
+
+/** CRC-32 of each byte value, generated from @c CRC32_POLY */
+static const u32_t g_crc32_table[256] =
+{
+    0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F,
+    0xE963A535, 0x9E6495A3, 0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988,
+    0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91, 0x1DB71064, 0x6AB020F2,
+    0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+    0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9,
+    0xFA0F3D63, 0x8D080DF5, 0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172,
+    0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B, 0x35B5A8FA, 0x42B2986C,
+    0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+    0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423,
+    0xCFBA9599, 0xB8BDA50F, 0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924,
+    0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D, 0x76DC4190, 0x01DB7106,
+    0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+    0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D,
+    0x91646C97, 0xE6635C01, 0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E,
+    0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457, 0x65B0D9C6, 0x12B7E950,
+    0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+    0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7,
+    0xA4D1C46D, 0xD3D6F4FB, 0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0,
+    0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9, 0x5005713C, 0x270241AA,
+    0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+    0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81,
+    0xB7BD5C3B, 0xC0BA6CAD, 0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A,
+    0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683, 0xE3630B12, 0x94643B84,
+    0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+    0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB,
+    0x196C3671, 0x6E6B06E7, 0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC,
+    0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5, 0xD6D6A3E8, 0xA1D1937E,
+    0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+    0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55,
+    0x316E8EEF, 0x4669BE79, 0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236,
+    0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F, 0xC5BA3BBE, 0xB2BD0B28,
+    0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+    0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F,
+    0x72076785, 0x05005713, 0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38,
+    0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21, 0x86D3D2D4, 0xF1D4E242,
+    0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+    0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69,
+    0x616BFFD3, 0x166CCF45, 0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2,
+    0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB, 0xAED16A4A, 0xD9D65ADC,
+    0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+    0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693,
+    0x54DE5729, 0x23D967BF, 0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94,
+    0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
+};
+
+/** Updates a CRC with one byte */
+#define CRC32_BYTE(c, b) (g_crc32_table[((c) ^ (b)) & 0xFF] ^ ((c) >> 8))
+
+/********************************************//**
+ *  \brief Computes a CRC-32
+ *  
+ *  Same as zlib's @c crc32, start with zero 
+ *  and pass the result to continue a CRC.
+ *  \returns Updated CRC
+ ***********************************************/
+u32_t
+crc32 (u32_t crc,           ///< CRC so far
+       const void *data,    ///< Data to add
+       u32_t length)        ///< Length of @a data
+{
+    const u8_t *p = data;
+
+    crc = ~crc;
+    while (length--)
+    {
+        crc = CRC32_BYTE (crc, *p++);
+    }
+    return ~crc;
+}
+
+/********************************************//**
+ *  \brief Copies memory and computes its 
+ *  CRC-32 in the same pass
+ *  
+ *  Each word is checksummed while it is in a 
+ *  register on its way to @a dst, so the data 
+ *  is only read once. Regions must not overlap.
+ *  \returns Updated CRC of the copied data
+ ***********************************************/
+u32_t
+crc32_copy (u32_t crc,          ///< CRC so far
+             void *dst,         ///< Where to copy to
+       const void *src,         ///< Where to copy from
+            u32_t length)       ///< Bytes to copy
+{
+    u8_t *d = dst;
+    const u8_t *s = src;
+    u32_t w;
+
+    crc = ~crc;
+    if ((((u32_t)d ^ (u32_t)s) & (sizeof (u32_t) - 1)) == 0)
+    {
+        for (; ((u32_t)s & (sizeof (u32_t) - 1)) && length > 0; length--)
+        {
+            crc = CRC32_BYTE (crc, *s);
+            *d++ = *s++;
+        }
+        for (; length >= sizeof (u32_t); length -= sizeof (u32_t))
+        {
+            w = *(const u32_t*)s;
+            *(u32_t*)d = w;
+            crc ^= w;
+            crc = g_crc32_table[crc & 0xFF] ^ (crc >> 8);
+            crc = g_crc32_table[crc & 0xFF] ^ (crc >> 8);
+            crc = g_crc32_table[crc & 0xFF] ^ (crc >> 8);
+            crc = g_crc32_table[crc & 0xFF] ^ (crc >> 8);
+            s += sizeof (u32_t);
+            d += sizeof (u32_t);
+        }
+    }
+    for (; length > 0; length--)
+    {
+        crc = CRC32_BYTE (crc, *s);
+        *d++ = *s++;
+    }
+    return ~crc;
+}
+
 /********************************************//**
  *  \brief Unsigned integer division
  *  
@@ -405,6 +586,94 @@ uidiv (u32_t num,   ///< Numerator
     return ans;
 }
 
+/********************************************//**
+ *  \brief Swaps two elements of an array
+ ***********************************************/
+static inline void
+qsort_swap (char *a,    ///< First element
+            char *b,    ///< Second element
+           u32_t size)  ///< Size of an element
+{
+    char tmp;
+
+    if (((u32_t)a | (u32_t)b | size) & (sizeof (u32_t) - 1))
+    {
+        while (size--)
+        {
+            tmp = *a;
+            *a++ = *b;
+            *b++ = tmp;
+        }
+        return;
+    }
+    for (; size > 0; size -= sizeof (u32_t), a += sizeof (u32_t), b += sizeof (u32_t))
+    {
+        u32_t word_tmp = *(u32_t*)a;
+        *(u32_t*)a = *(u32_t*)b;
+        *(u32_t*)b = word_tmp;
+    }
+}
+
+/********************************************//**
+ *  \brief Restores the heap property below 
+ *  element @a root
+ ***********************************************/
+static void
+qsort_sift_down (char *base,    ///< Array
+                u32_t root,     ///< Element to sift down
+                u32_t num,      ///< Number of elements in the heap
+                u32_t size,     ///< Size of an element
+                  int (*compar)(const void *, const void *)) ///< Comparison function
+{
+    u32_t child;
+
+    while ((child = 2 * root + 1) < num)
+    {
+        if (child + 1 < num && compar (base + child * size, base + (child + 1) * size) < 0)
+        {
+            child++;
+        }
+        if (compar (base + root * size, base + child * size) >= 0)
+        {
+            return;
+        }
+        qsort_swap (base + root * size, base + child * size, size);
+        root = child;
+    }
+}
+
+/********************************************//**
+ *  \brief Sorts an array
+ *  
+ *  Implemented as a heapsort so it needs no 
+ *  extra memory and never degrades past 
+ *  O(n log n). The sort is not stable, so 
+ *  @a compar must break ties itself if the 
+ *  order of equal elements matters.
+ ***********************************************/
+void
+qsort (void *base,      ///< Array to sort
+      u32_t num,        ///< Number of elements
+      u32_t size,       ///< Size of an element
+        int (*compar)(const void *, const void *)) ///< Returns negative, zero, or positive like @c memcmp
+{
+    u32_t i;
+
+    if (num < 2 || size == 0)
+    {
+        return;
+    }
+    for (i = num / 2; i > 0; i--)
+    {
+        qsort_sift_down (base, i - 1, num, size, compar);
+    }
+    for (i = num - 1; i > 0; i--)
+    {
+        qsort_swap (base, (char*)base + i * size, size);
+        qsort_sift_down (base, 0, i, size, compar);
+    }
+}
+
 // thanks naehrwert for the tiny printf
 static void _putn(char **p_str, u32_t x, u32_t base, char fill, int fcnt, int upper)
 {
@@ -534,6 +803,7 @@ int sprintf (char *str, const char *format, ...)
 }
 
 int g_fd_log = 0;
+console_t *g_console = NULL;
 
 /********************************************//**
  *  \brief Sets the logging function
@@ -546,6 +816,42 @@ vita_init_log ()
     psvLockMem ();
 }
 
+/********************************************//**
+ *  \brief Sets the console to log to
+ *  
+ *  The console must already be set up with 
+ *  uvl_console_init(). Pass NULL to stop 
+ *  logging to screen.
+ ***********************************************/
+void
+vita_init_console (console_t *console) ///< Console to log to
+{
+    psvUnlockMem ();
+    g_console = console;
+    psvLockMem ();
+    if (console != NULL)
+    {
+        uvl_console_flush (console, 0, 1);
+    }
+}
+
+/********************************************//**
+ *  \brief Draws everything logged to the console
+ *  
+ *  Lines logged within a frame of the last 
+ *  redraw wait for the next line. Call this 
+ *  before stopping or handing over so they 
+ *  are not lost.
+ ***********************************************/
+void
+vita_flush_console ()
+{
+    if (g_console != NULL)
+    {
+        uvl_console_flush (g_console, sceKernelGetSystemTimeLow (), 1);
+    }
+}
+
 /********************************************//**
  *  \brief Writes a log entry
  *  
@@ -572,5 +878,9 @@ vita_logf (char *file,   ///< Source file of code writing to log
     {
         sceIoWrite (g_fd_log, log_line, strlen (log_line));
     }
-    // TODO: print to screen
+    if (g_console != NULL)
+    {
+        uvl_console_print (g_console, log_line);
+        uvl_console_flush (g_console, sceKernelGetSystemTimeLow (), 0);
+    }
 }
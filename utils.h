@@ -32,6 +32,12 @@
 #define LOG(args...) \
         vita_logf (__FILE__, __LINE__, args)  ///< Write a log entry
 
+/** \cond predefined-types
+ *  @{
+ */
+typedef struct console console_t;
+/** @}*/
+
 /** \name stdarg.h functions
  *  See @c stdarg.h documentation for details.
  *  @{
@@ -92,6 +98,13 @@ void* memset (void *ptr, int value, u32_t num);
 u32_t strlen (const char *str);
 /** @}*/
 
+/** \name stdlib.h functions
+ *  See @c stdlib.h documention for details.
+ *  @{
+ */
+void qsort (void *base, u32_t num, u32_t size, int (*compar)(const void *, const void *));
+/** @}*/
+
 /** \name stdio.h functions
  *  See @c stdio.h documention for details.
  *  @{
@@ -104,8 +117,13 @@ int sprintf (char *str, const char *format, ...);
  *  @{
  */
 char* memstr (char *haystack, int h_length, char *needle, int n_length);
+int nid_find (const u32_t *table, u32_t length, const u32_t *needles, u32_t n_needles);
+u32_t crc32 (u32_t crc, const void *data, u32_t length);
+u32_t crc32_copy (u32_t crc, void *dst, const void *src, u32_t length);
 uidiv_result_t uidiv (u32_t num, u32_t dem);
 void vita_init_log ();
+void vita_init_console (console_t *console);
+void vita_flush_console ();
 void vita_logf (char *file, int line, ...);
 /** @}*/
 
@@ -14,8 +14,11 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include "bench.h"
+#include "catalog.h"
 #include "cleanup.h"
 #include "config.h"
+#include "console.h"
 #include "load.h"
 #include "resolve.h"
 #include "scefuncs.h"
@@ -41,7 +44,12 @@ uvl_start ()
 {
     uvl_scefuncs_resolve_loader (); // must be first
     vita_init_log ();
+    uvl_stats_init (); // no-op unless built with UVL_STATS
     LOG ("UVLoader %u.%u.%u started.", UVL_VER_MAJOR, UVL_VER_MINOR, UVL_VER_REV);
+#ifdef UVL_BENCH
+    // benchmark build does not load anything
+    return uvl_bench_run (UVL_BENCH_PATH);
+#endif
     PsvUID uvl_thread;
 
     IF_DEBUG LOG ("Creating thread to run loader.");
@@ -68,6 +76,60 @@ uvl_start ()
     return 0;
 }
 
+/********************************************//**
+ *  \brief Draws the log on screen
+ *  
+ *  The console draws over whatever frame the 
+ *  game last showed. Needs the resolve table 
+ *  to find SceDisplay.
+ *  \returns Zero on success, otherwise error
+ ***********************************************/
+static int
+uvl_console_setup ()
+{
+    PsvDisplayFrameBuf frame;
+    console_t *console;
+    PsvUID block;
+
+    if (uvl_scefuncs_resolve_display () < 0)
+    {
+        LOG ("Cannot resolve display functions.");
+        return -1;
+    }
+    memset (&frame, 0, sizeof (frame));
+    frame.size = sizeof (frame);
+    if (sceDisplayGetFrameBuf (&frame, PSP2_DISPLAY_SETBUF_NEXTFRAME) < 0 || frame.base == NULL)
+    {
+        LOG ("Cannot get framebuffer.");
+        return -1;
+    }
+    if (frame.pixelformat != PSP2_DISPLAY_PIXELFORMAT_A8B8G8R8)
+    {
+        LOG ("Framebuffer format 0x%08X not supported.", frame.pixelformat);
+        return -1;
+    }
+    block = sceKernelAllocMemBlock ("UVLConsole", 0xC20D060, (sizeof (console_t) + 0xFFF) & ~0xFFF, NULL);
+    if (block < 0)
+    {
+        LOG ("Cannot allocate console. 0x%08X", block);
+        return -1;
+    }
+    if (sceKernelGetMemBlockBase (block, (void**)&console) < 0)
+    {
+        LOG ("Cannot get console address.");
+        sceKernelFreeMemBlock (block);
+        return -1;
+    }
+    if (uvl_console_init (console, frame.base, frame.width, frame.height, frame.pitch, 0xFFFFFFFF, 0xFF000000) < 0)
+    {
+        LOG ("Cannot set up console.");
+        sceKernelFreeMemBlock (block);
+        return -1;
+    }
+    vita_init_console (console);
+    return 0;
+}
+
 /********************************************//**
  *  \brief Entry point of UVLoader
  *  
@@ -91,27 +153,50 @@ uvl_entry ()
         LOG ("Cannot cache all loaded entries.");
         return -1;
     }
+    if (UVL_LOG_CONSOLE)
+    {
+        IF_DEBUG LOG ("Setting up on screen log.");
+        if (uvl_console_setup () < 0)
+        {
+            LOG ("Cannot draw log on screen. Continuing.");
+        }
+    }
     IF_DEBUG LOG ("Adding custom exit() hook.");
     resolve_entry_t exit_resolve = { EXIT_NID, RESOLVE_TYPE_FUNCTION, 0, uvl_exit };
     if (uvl_resolve_table_add (&exit_resolve) < 0)
     {
         LOG ("Cannot add resolve for exit().");
+        vita_flush_console ();
         return -1;
     }
     IF_DEBUG LOG ("Exit at 0x%08X", exit_resolve.value.value);
+    if (UVL_CATALOG_DIR[0] != '\0')
+    {
+        IF_DEBUG LOG ("Updating homebrew catalog.");
+        if (uvl_catalog_update (UVL_CATALOG_DIR, UVL_CATALOG_PATH) < 0)
+        {
+            LOG ("Cannot update homebrew catalog. Continuing.");
+        }
+    }
     IF_DEBUG LOG ("Loading homebrew.");
     if (uvl_load_exe (UVL_HOMEBREW_PATH, (void**)&start) < 0)
     {
         LOG ("Cannot load homebrew.");
+        vita_flush_console ();
         return -1;
     }
     IF_DEBUG LOG ("Freeing resolve table.");
     if (uvl_resolve_table_destroy () < 0)
     {
         LOG ("Cannot destroy resolve table.");
+        vita_flush_console ();
         return -1;
     }
+    uvl_stats_dump ("load");
     IF_DEBUG LOG ("Running the homebrew.");
+    vita_flush_console ();
+    // the homebrew owns the display from here, its framebuffer is not ours to draw on
+    vita_init_console (NULL);
     ret_value = start (0, NULL);
     // should not reach here
     IF_DEBUG LOG ("Homebrew exited with value 0x%08X", ret_value);
@@ -129,6 +214,8 @@ int
 uvl_exit (int status)
 {
     IF_DEBUG LOG ("Exit called with status: 0x%08X", status);
+    uvl_stats_dump ("exit");
+    uvl_resolve_trap_dump ();
     IF_DEBUG LOG ("Removing application thread.");
     if (sceKernelExitDeleteThread (0) < 0)
     {